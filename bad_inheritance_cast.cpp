@@ -1,7 +1,14 @@
 #include <cassert>
+#include <cstddef>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <variant>
+#include <vector>
 
 class Interface {
 public:
+	using input = std::variant<int, double>; // one alternative per check overload, see check_batch
 	virtual int check(int a) { return 1; }
 	virtual int check(double b) { return 2; }
 };
@@ -18,6 +25,39 @@ public:
 	int check(double a) override { return 4; }
 };
 
+// the check overload taking exactly T - does not compile if there is none, so nothing gets converted on the way
+template <typename T>
+constexpr auto check_overload = static_cast<int (Interface::*)(T)>(&Interface::check);
+
+template <typename... Ts>
+struct batch_groups {
+	std::tuple<std::vector<std::pair<std::size_t, Ts>>...> groups; // position in the input and the value, per alternative
+
+	batch_groups(const std::vector<std::variant<Ts...>> &inputs) {
+		for (std::size_t i = 0; i < inputs.size(); ++i) {
+			std::visit([&](auto value) { std::get<std::vector<std::pair<std::size_t, decltype(value)>>>(groups).push_back({ i, value }); }, inputs[i]);
+		}
+	}
+
+	// one tight loop per overload, all of its calls go to the same final overrider
+	template <typename T>
+	void check(Interface &target, std::vector<int> &results) const {
+		constexpr auto overload = check_overload<T>;
+		for (const auto &[i, value]: std::get<std::vector<std::pair<std::size_t, T>>>(groups)) results[i] = (target.*overload)(value);
+	}
+};
+
+// calls the check overload matching each input exactly, grouped by type - results are in the order of the inputs
+template <typename... Ts>
+std::vector<int> check_batch(Interface &target, const std::vector<std::variant<Ts...>> &inputs) {
+	static_assert(std::is_same_v<std::variant<Ts...>, Interface::input>, "the inputs have to be Interface::input, one alternative per check overload");
+
+	batch_groups<Ts...> batch(inputs);
+	std::vector<int> results(inputs.size());
+	(batch.template check<Ts>(target, results), ...);
+	return results;
+}
+
 int main() {
 	Derived d;
 
@@ -29,5 +69,11 @@ int main() {
 	assert(ud.check(1.0) == 4);
 	assert(ud.check(1) == 1);
 
+	// batches go to the overload of the input's type, whatever the derived class hides
+	std::vector<Interface::input> inputs { 1, 2.0, 3, 4.5, 5 };
+	assert((check_batch(d, inputs) == std::vector<int>{ 1, 3, 1, 3, 1 }));
+	assert((check_batch(ud, inputs) == std::vector<int>{ 1, 4, 1, 4, 1 }));
+	assert(check_batch(d, std::vector<Interface::input>{}).empty());
+
 	return 0;
 }
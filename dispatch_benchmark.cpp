@@ -0,0 +1,349 @@
+// Cost of one dispatch through each of the type erasure mechanisms of this repo, against a direct call.
+// Every mechanism gets the same workload: a sequence of items alternating between two types, each one handed to the
+// handler for its type, which adds a small number to a sink. Output is a JSON array, one object per mechanism.
+
+// everything the demos include - they are included into namespaces below, where their own includes have to be no-ops
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <cxxabi.h>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <numeric>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <typeinfo>
+#include <utility>
+#include <vector>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+// the demos, with their mains renamed
+#define main demo_main
+
+namespace lambda_visitor {
+#include "lambda_visitor.cpp"
+}
+
+namespace lambda_visitor2 {
+#include "lambda_visitor2.cpp"
+}
+
+namespace polymorphic_vector {
+#include "polymorphic_vector.cpp"
+}
+
+namespace interface_wrapper_demo {
+#include "interface_wrapper.cpp"
+}
+
+// calls ::draw and ::render by their qualified names, so it stays in the global namespace
+#include "value_concepts.cpp"
+
+#undef main
+
+// te_multitype_ptree_holder - rangesv3_ptree.cpp needs boost and range-v3, this is the same dispatch without them:
+// a virtual call through the reference_wrapper of a (key, holder) pair in a deque
+namespace ptree_holder {
+	struct te_holder {
+		virtual ~te_holder() = default;
+		virtual void visit() const = 0;
+	};
+
+	template <typename T>
+	struct holder: te_holder {
+		T& obj;
+		holder(T& _obj): obj(_obj) {}
+		void visit() const override;
+	};
+
+	using container_type = std::deque<std::pair<std::string, std::reference_wrapper<te_holder>>>;
+}
+
+
+static std::atomic<std::size_t> allocations { 0 };
+
+void* operator new(std::size_t size) {
+	++allocations;
+	if (void* p = std::malloc(size ? size : 1)) return p;
+	throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+
+// what the handlers do - a global, so none of the calls can be dropped
+long sink = 0;
+
+struct item_a { int value; };
+struct item_b { int value; };
+
+// the baseline handler, called directly but never inlined
+__attribute__((noinline)) void handle(int value) { sink += value; }
+
+template <>
+void draw(const item_a& a, std::ostream&, int) { sink += a.value; }
+
+template <>
+void draw(const item_b& b, std::ostream&, int) { sink += b.value; }
+
+template <typename T>
+void ptree_holder::holder<T>::visit() const { sink += obj.value; }
+
+// instructions and branch misses of the calling thread, when the kernel lets us count them
+class perf_counters {
+	int _group = -1;
+	int _misses = -1;
+
+	static int open(std::uint64_t config, int group) {
+		perf_event_attr attr;
+		std::memset(&attr, 0, sizeof(attr));
+		attr.size = sizeof(attr);
+		attr.type = PERF_TYPE_HARDWARE;
+		attr.config = config;
+		attr.disabled = group == -1;
+		attr.exclude_kernel = 1;
+		attr.exclude_hv = 1;
+		attr.read_format = PERF_FORMAT_GROUP;
+		return static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, group, 0));
+	}
+
+public:
+	struct values {
+		std::uint64_t instructions;
+		std::uint64_t branch_misses;
+	};
+
+	perf_counters() {
+		_group = open(PERF_COUNT_HW_INSTRUCTIONS, -1);
+		if (_group >= 0) _misses = open(PERF_COUNT_HW_BRANCH_MISSES, _group);
+		if (_misses < 0 && _group >= 0) {
+			close(_group);
+			_group = -1;
+		}
+	}
+
+	perf_counters(const perf_counters&) = delete;
+	perf_counters& operator=(const perf_counters&) = delete;
+
+	~perf_counters() {
+		if (_misses >= 0) close(_misses);
+		if (_group >= 0) close(_group);
+	}
+
+	bool available() const { return _group >= 0; }
+
+	void start() {
+		if (!available()) return;
+		ioctl(_group, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+		ioctl(_group, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+	}
+
+	values stop() {
+		if (!available()) return { 0, 0 };
+		ioctl(_group, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+		std::uint64_t read_values[3] = {}; // number of events, then the events in the order they were opened
+		if (read(_group, read_values, sizeof(read_values)) != sizeof(read_values)) return { 0, 0 };
+		return { read_values[1], read_values[2] };
+	}
+};
+
+struct result {
+	const char* mechanism;
+	std::size_t calls;
+	double ns_per_call;
+	double allocations_per_call;
+	bool counted;
+	double instructions_per_call;
+	double branch_misses_per_call;
+};
+
+// runs f rounds times - f performs calls_per_round dispatches
+template <typename F>
+result measure(const char* mechanism, perf_counters& counters, std::size_t calls_per_round, std::size_t rounds, F f) {
+	f(); // warm up, also takes out one time allocations
+	std::size_t allocations_before = allocations;
+	counters.start();
+	auto start = std::chrono::steady_clock::now();
+	for (std::size_t r = 0; r < rounds; ++r) f();
+	std::chrono::duration<double, std::nano> took = std::chrono::steady_clock::now() - start;
+	auto counted = counters.stop();
+	double calls = static_cast<double>(calls_per_round * rounds);
+	return { mechanism, calls_per_round * rounds, took.count() / calls, (allocations - allocations_before) / calls,
+	         counters.available(), counted.instructions / calls, counted.branch_misses / calls };
+}
+
+void print_json(std::ostream& out, const std::vector<result>& results) {
+	out << "[\n";
+	for (std::size_t i = 0; i < results.size(); ++i) {
+		const auto& r = results[i];
+		out << "{\"mechanism\":\"" << r.mechanism << "\",\"calls\":" << r.calls << ",\"ns_per_call\":" << r.ns_per_call
+		    << ",\"allocations_per_call\":" << r.allocations_per_call << ",\"instructions_per_call\":";
+		if (r.counted) out << r.instructions_per_call; else out << "null";
+		out << ",\"branch_misses_per_call\":";
+		if (r.counted) out << r.branch_misses_per_call; else out << "null";
+		out << (i + 1 < results.size() ? "},\n" : "}\n");
+	}
+	out << "]\n";
+}
+
+// keeps the compiler from seeing what is behind a pointer, so nothing gets devirtualized
+template <typename T>
+__attribute__((noinline)) T* opaque(T* p) {
+	asm volatile("" : : "r"(p) : "memory");
+	return p;
+}
+
+int main() {
+	const std::size_t items = 1 << 16;
+	const std::size_t rounds = 200;
+	perf_counters counters;
+	std::vector<result> results;
+
+	// direct call
+	{
+		std::vector<int> values(items);
+		std::iota(values.begin(), values.end(), 0);
+		results.push_back(measure("direct", counters, items, rounds, [&] {
+			for (int v: values) handle(v);
+		}));
+	}
+
+	// Visitor - virtual accept, then the std::function for the type out of a tuple
+	{
+		using namespace lambda_visitor;
+		std::vector<std::shared_ptr<Base>> objects;
+		for (std::size_t i = 0; i < items; ++i) {
+			if (i % 2) objects.push_back(std::make_shared<B>()); else objects.push_back(std::make_shared<A>());
+		}
+		auto visitor = BaseVisitor([](const A&) { sink += 1; }, [](const B&) { sink += 2; });
+		results.push_back(measure("Visitor", counters, items, rounds, [&] {
+			for (const auto& o: objects) o->accept(visitor);
+		}));
+	}
+
+	// AnyVisitor - virtual accept, dynamic_pointer_cast to the holder for the type, then its std::function
+	{
+		using namespace lambda_visitor2;
+		std::vector<std::unique_ptr<Visitable>> objects;
+		for (std::size_t i = 0; i < items; ++i) {
+			if (i % 2) objects.emplace_back(new DerivedClass2()); else objects.emplace_back(new DerivedClass1());
+		}
+		auto visitor = AnyVisitor::createVisitor<DerivedClass1&, DerivedClass2&>(
+			[](DerivedClass1&) { sink += 1; },
+			[](DerivedClass2&) { sink += 2; }
+		);
+		results.push_back(measure("AnyVisitor", counters, items, rounds, [&] {
+			for (const auto& o: objects) o->accept(visitor);
+		}));
+	}
+
+	// interface_wrapper - call through a member function pointer into the erased implementation
+	{
+		using namespace interface_wrapper_demo;
+		using creator = interface_wrapper<interface1, interface2>::concrete_creator<c_handler1, c_handler2>;
+		std::vector<decltype(creator::create_unique(1.0))> owners; // deleted as what they are, interface_wrapper has no virtual destructor
+		std::vector<interface_wrapper<interface1, interface2>*> wrappers;
+		for (std::size_t i = 0; i < items; ++i) {
+			owners.push_back(creator::create_unique(1.0));
+			wrappers.push_back(owners.back().get());
+		}
+		results.push_back(measure("interface_wrapper", counters, items, rounds, [&] {
+			int k = 0;
+			for (auto w: wrappers) sink += w->call(&interface1::twice, k++);
+		}));
+	}
+
+	// multi_interface - broadcast to every implementation, each one is a call
+	{
+		using namespace interface_wrapper_demo;
+		c_worker first(0), second(0); // no delay, work(i) returns i
+		multi_interface<worker_interface> multi(&first, &second);
+		auto* broadcast = opaque(&multi);
+		results.push_back(measure("multi_interface", counters, items, rounds, [&] {
+			for (std::size_t i = 0; i < items / 2; ++i) (*broadcast)[&worker_interface::work](static_cast<int>(i));
+		}));
+	}
+
+	// drawable_ptr - one virtual call per entry
+	{
+		std::vector<drawable_ptr> entries;
+		for (std::size_t i = 0; i < items; ++i) {
+			if (i % 2) entries.emplace_back(item_b{ 2 }); else entries.emplace_back(item_a{ 1 });
+		}
+		std::ostream null_out(nullptr);
+		results.push_back(measure("drawable_ptr", counters, items, rounds, [&] {
+			for (const auto& entry: entries) draw(entry, null_out, 0);
+		}));
+	}
+
+	// document_t - one virtual call per chunk of 256 entries, then the draw of each entry. Alternating types leave every
+	// chunk mixed, so that is still a virtual call per entry; in runs of 1000 most chunks are typed and called directly
+	{
+		document_t alternating, runs;
+		for (std::size_t i = 0; i < items; ++i) {
+			if (i % 2) alternating.emplace_back(item_b{ 2 }); else alternating.emplace_back(item_a{ 1 });
+			if (i / 1000 % 2) runs.emplace_back(item_b{ 2 }); else runs.emplace_back(item_a{ 1 });
+		}
+		std::ostream null_out(nullptr);
+		results.push_back(measure("document_t", counters, items, rounds, [&] { draw(alternating, null_out, 0); }));
+		results.push_back(measure("document_t runs", counters, items, rounds, [&] { draw(runs, null_out, 0); }));
+	}
+
+	// te_multitype_ptree_holder
+	{
+		using namespace ptree_holder;
+		std::vector<item_a> as(items / 2, item_a{ 1 });
+		std::vector<item_b> bs(items / 2, item_b{ 2 });
+		std::vector<std::unique_ptr<te_holder>> holders;
+		container_type children;
+		for (std::size_t i = 0; i < items; ++i) {
+			if (i % 2) holders.emplace_back(new holder<item_b>(bs[i / 2])); else holders.emplace_back(new holder<item_a>(as[i / 2]));
+			children.emplace_back("child", std::ref(*holders.back()));
+		}
+		results.push_back(measure("te_multitype_ptree_holder", counters, items, rounds, [&] {
+			for (const auto& child: children) child.second.get().visit();
+		}));
+	}
+
+	// CompositeVector - a std::function call per element, one type after the other
+	{
+		using namespace polymorphic_vector;
+		std::vector<A> as;
+		std::vector<B> bs;
+		for (std::size_t i = 0; i < items / 2; ++i) {
+			as.emplace_back(1);
+			bs.emplace_back(2.0);
+		}
+		const auto composite = CompositeVector<A, B>(as, bs);
+		const auto al = [](const A& a) { sink += a.a; };
+		const auto bl = [](const B& b) { sink += static_cast<long>(b.b); };
+		results.push_back(measure("CompositeVector", counters, items, rounds, [&] { composite.visit(al, bl); }));
+	}
+
+	print_json(std::cout, results);
+	return sink == 0; // the sink has to be used
+}
@@ -1,14 +1,454 @@
 #include <iostream>
 #include <cassert>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include <utility>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <sstream>
+#include <cxxabi.h>
 
 using namespace std;
 
+/*
+Epoch based reclamation for globals replaced at runtime (config reloads) while other threads keep calling them.
+A reader announces the epoch it started in, an object swapped out in epoch e is deleted once every reader is past e.
+Reads never wait - an announcement, a load and a release. Writers are serialized but do not wait for the readers either,
+whatever cannot be deleted yet is deleted by one of the later swaps (or by synchronize).
+*/
+namespace epoch {
+	/* one per thread that ever read, reused once the thread exits */
+	struct reader_slot {
+		std::atomic<std::uint64_t> epoch { 0 }; /* 0 outside of reads */
+		std::atomic<bool> in_use { true };
+		unsigned depth = 0; /* nested reads, only the outermost one announces */
+		reader_slot *next = nullptr;
+		char padding[64]; /* readers announcing must not share cache lines */
+	};
+
+	class domain {
+		struct retired {
+			void *object;
+			void (*destroy)(void *);
+			std::uint64_t epoch;
+		};
+
+		std::atomic<std::uint64_t> _epoch { 1 };
+		std::atomic<reader_slot *> _readers { nullptr }; /* only ever grows, slots are reused */
+
+		std::mutex _writer;
+		std::vector<retired> _retired;
+
+		domain() = default;
+
+		/* the lowest epoch a reader is still in */
+		std::uint64_t oldest_reader() const {
+			std::uint64_t oldest = UINT64_MAX;
+			for (auto r = _readers.load(std::memory_order_acquire); r; r = r->next) {
+				auto e = r->epoch.load(std::memory_order_seq_cst);
+				if (e && e < oldest) oldest = e;
+			}
+			return oldest;
+		}
+
+		/* with _writer held, returns what can be deleted - deleting is done after unlocking */
+		std::vector<retired> reclaimable() {
+			auto oldest = oldest_reader();
+			auto still_read = std::partition(_retired.begin(), _retired.end(), [oldest](const retired &r) { return r.epoch > oldest; });
+			std::vector<retired> done(still_read, _retired.end());
+			_retired.erase(still_read, _retired.end());
+			return done;
+		}
+
+		static void destroy(const std::vector<retired> &objects) {
+			for (const auto &r: objects) r.destroy(r.object);
+		}
+
+		reader_slot &acquire_slot() {
+			for (auto r = _readers.load(std::memory_order_acquire); r; r = r->next) {
+				bool in_use = false;
+				if (r->in_use.compare_exchange_strong(in_use, true)) return *r;
+			}
+			auto r = new reader_slot;
+			r->next = _readers.load(std::memory_order_relaxed);
+			while (!_readers.compare_exchange_weak(r->next, r, std::memory_order_release, std::memory_order_relaxed));
+			return *r;
+		}
+
+		void release_slot(reader_slot &r) {
+			r.depth = 0;
+			r.epoch.store(0, std::memory_order_release);
+			r.in_use.store(false, std::memory_order_release);
+		}
+
+	public:
+		domain(const domain &) = delete;
+		domain &operator=(const domain &) = delete;
+
+		~domain() {
+			destroy(_retired);
+			for (auto r = _readers.load(); r;) delete std::exchange(r, r->next);
+		}
+
+		static domain &instance() {
+			static domain d;
+			return d;
+		}
+
+		/* the slot of the calling thread */
+		static reader_slot &local_slot() {
+			struct registration {
+				reader_slot &slot = instance().acquire_slot();
+				~registration() { instance().release_slot(slot); }
+			};
+			thread_local registration r;
+			return r.slot;
+		}
+
+		/* the announcement has to be visible before the object is loaded, hence seq_cst - see retire */
+		void enter(reader_slot &r) {
+			if (r.depth++ == 0) r.epoch.store(_epoch.load(std::memory_order_acquire), std::memory_order_seq_cst);
+		}
+
+		void leave(reader_slot &r) {
+			if (--r.depth == 0) r.epoch.store(0, std::memory_order_release);
+		}
+
+		/*
+		object must already be unreachable for new readers. Readers that announce the epoch started here load after the
+		swap so they cannot see it, the ones that announced an older epoch may still hold it.
+		*/
+		template <typename T>
+		void retire(T *object) {
+			std::vector<retired> done;
+			{
+				std::lock_guard<std::mutex> lock(_writer);
+				auto e = _epoch.fetch_add(1, std::memory_order_seq_cst) + 1;
+				_retired.push_back({ object, [](void *p) { delete static_cast<T *>(p); }, e });
+				done = reclaimable();
+			}
+			destroy(done);
+		}
+
+		/* waits until everything retired so far is deleted - never call it from inside a read */
+		void synchronize() {
+			for (;;) {
+				std::vector<retired> done;
+				bool empty;
+				{
+					std::lock_guard<std::mutex> lock(_writer);
+					done = reclaimable();
+					empty = _retired.empty();
+				}
+				destroy(done);
+				if (empty) return;
+				std::this_thread::yield();
+			}
+		}
+	};
+} // epoch
+
+/* a global object that can be replaced while other threads call it, T needs a virtual destructor if derived ones are published */
+template <typename T>
+class hot_swappable {
+	std::atomic<T *> _current;
+
+public:
+	/* keeps the object alive while held - hold it only for the duration of a call */
+	class reference {
+		epoch::reader_slot *_slot;
+		T *_object;
+
+	public:
+		reference(epoch::reader_slot &slot, const std::atomic<T *> &current): _slot(&slot) {
+			epoch::domain::instance().enter(slot);
+			_object = current.load(std::memory_order_seq_cst);
+		}
+		reference(reference &&other): _slot(std::exchange(other._slot, nullptr)), _object(other._object) {}
+		reference(const reference &) = delete;
+		reference &operator=(const reference &) = delete;
+		~reference() { if (_slot) epoch::domain::instance().leave(*_slot); }
+
+		T *get() const { return _object; }
+		T *operator->() const { return _object; }
+		T &operator*() const { return *_object; }
+		explicit operator bool() const { return _object != nullptr; }
+	};
+
+	/* the domain has to outlive every global using it */
+	explicit hot_swappable(std::unique_ptr<T> initial = nullptr): _current(initial.release()) { epoch::domain::instance(); }
+
+	hot_swappable(const hot_swappable &) = delete;
+	hot_swappable &operator=(const hot_swappable &) = delete;
+
+	~hot_swappable() {
+		publish(nullptr);
+		epoch::domain::instance().synchronize();
+	}
+
+	reference get() const { return reference(epoch::domain::local_slot(), _current); }
+
+	/* the previous object is deleted once the readers that could have seen it are done */
+	void publish(std::unique_ptr<T> object) {
+		if (T *previous = _current.exchange(object.release(), std::memory_order_seq_cst)) epoch::domain::instance().retire(previous);
+	}
+};
+
+
+/*
+Registry of global services, each one defined with the services it depends on and created by a factory taking them.
+start() creates the eager ones on a few threads, every service once all of its dependencies are there.
+Lazy ones are created by the first get, with their dependencies. Once created, get<S>() is a single load.
+*/
+namespace services {
+	enum class startup { eager, lazy };
+
+	namespace detail {
+		using clock = std::chrono::steady_clock;
+
+		struct definition {
+			std::string name;
+			startup when;
+			std::vector<definition *> dependencies;
+			std::function<void()> construct; /* publishes the instance into its slot */
+			std::function<void()> destroy;
+			std::once_flag once;
+
+			/* see report */
+			clock::time_point started;
+			clock::duration took {};
+			bool lazily = false;
+
+			/* lazily when reached from get, with the dependencies it creates on the way */
+			void initialize(bool lazily);
+		};
+
+		template <typename S>
+		struct slot {
+			static std::atomic<S *> instance;
+			static definition *defined;
+		};
+
+		template <typename S>
+		std::atomic<S *> slot<S>::instance { nullptr };
+
+		template <typename S>
+		definition *slot<S>::defined = nullptr;
+
+		/* readable name of S for the report and the errors */
+		template <typename S>
+		std::string name() {
+			int status = 0;
+			std::unique_ptr<char, void (*)(void *)> demangled(abi::__cxa_demangle(typeid(S).name(), nullptr, nullptr, &status), std::free);
+			return status == 0? demangled.get() : typeid(S).name();
+		}
+
+		class registry {
+			std::mutex _mutex;
+			std::vector<std::unique_ptr<definition>> _definitions;
+			std::vector<definition *> _created; /* in order of creation, destroyed in reverse */
+			clock::time_point _begin = clock::now();
+
+			registry() {
+				/* services may hold epoch based globals, the domain has to outlive them */
+				epoch::domain::instance();
+			}
+
+		public:
+			~registry() { shutdown(); }
+
+			static registry &instance() {
+				static registry r;
+				return r;
+			}
+
+			definition &add(std::unique_ptr<definition> d) {
+				std::lock_guard<std::mutex> lock(_mutex);
+				_definitions.push_back(std::move(d));
+				return *_definitions.back();
+			}
+
+			void created(definition &d) {
+				std::lock_guard<std::mutex> lock(_mutex);
+				_created.push_back(&d);
+			}
+
+			void start(unsigned threads);
+			void report(std::ostream &out);
+
+			void shutdown() {
+				std::vector<definition *> created;
+				{
+					std::lock_guard<std::mutex> lock(_mutex);
+					created.swap(_created);
+				}
+				for (auto d = created.rbegin(); d != created.rend(); ++d) (*d)->destroy();
+			}
+		};
+
+		inline void definition::initialize(bool lazily) {
+			std::call_once(once, [this, lazily] {
+				for (auto d: dependencies) d->initialize(lazily);
+				this->lazily = lazily;
+				started = clock::now();
+				construct();
+				took = clock::now() - started;
+				registry::instance().created(*this);
+			});
+		}
+
+		/* eager services and what they depend on, each created once its dependencies are */
+		inline void registry::start(unsigned threads) {
+			std::vector<definition *> needed;
+			{
+				std::lock_guard<std::mutex> lock(_mutex);
+				std::vector<definition *> stack;
+				for (auto &d: _definitions) if (d->when == startup::eager) stack.push_back(d.get());
+				while (!stack.empty()) {
+					auto d = stack.back();
+					stack.pop_back();
+					if (std::find(needed.begin(), needed.end(), d) != needed.end()) continue;
+					needed.push_back(d);
+					stack.insert(stack.end(), d->dependencies.begin(), d->dependencies.end());
+				}
+			}
+
+			std::vector<std::size_t> waiting_for(needed.size());
+			std::vector<std::vector<std::size_t>> dependents(needed.size());
+			std::deque<std::size_t> ready;
+			for (std::size_t i = 0; i < needed.size(); ++i) {
+				for (auto dependency: needed[i]->dependencies) {
+					dependents[std::find(needed.begin(), needed.end(), dependency) - needed.begin()].push_back(i);
+				}
+				waiting_for[i] = needed[i]->dependencies.size();
+				if (!waiting_for[i]) ready.push_back(i);
+			}
+
+			std::mutex m;
+			std::condition_variable changed;
+			std::size_t done = 0;
+			std::exception_ptr failure;
+			auto worker = [&] {
+				std::unique_lock<std::mutex> lock(m);
+				for (;;) {
+					changed.wait(lock, [&] { return !ready.empty() || done == needed.size() || failure; });
+					if (done == needed.size() || failure) return;
+					auto i = ready.front();
+					ready.pop_front();
+					lock.unlock();
+					try {
+						needed[i]->initialize(false);
+					} catch (...) {
+						lock.lock();
+						failure = std::current_exception();
+						changed.notify_all();
+						return;
+					}
+					lock.lock();
+					++done;
+					for (auto dependent: dependents[i]) if (!--waiting_for[dependent]) ready.push_back(dependent);
+					changed.notify_all();
+				}
+			};
+
+			{
+				std::vector<std::thread> pool;
+				for (unsigned t = 1; t < std::max(1u, threads); ++t) pool.emplace_back(worker);
+				worker();
+				for (auto &t: pool) t.join();
+			}
+
+			if (failure) std::rethrow_exception(failure);
+		}
+
+		inline void registry::report(std::ostream &out) {
+			std::lock_guard<std::mutex> lock(_mutex);
+			for (auto d: _created) {
+				std::chrono::duration<double, std::milli> at = d->started - _begin, took = d->took;
+				out << d->name << ": " << (d->lazily? "lazy" : "startup") << ", created at " << at.count() << " ms, took " << took.count() << " ms" << std::endl;
+			}
+		}
+
+		template <typename S>
+		__attribute__((noinline)) S &create() {
+			auto d = slot<S>::defined;
+			if (!d) throw std::logic_error("Service " + name<S>() + " is not defined");
+			d->initialize(true);
+			S *s = slot<S>::instance.load(std::memory_order_acquire);
+			if (!s) throw std::logic_error("Service " + d->name + " is shut down");
+			return *s;
+		}
+	} // detail
+
+	/* the service, created first if it is lazy or startup did not get to it yet */
+	template <typename S>
+	S &get() {
+		if (S *s = detail::slot<S>::instance.load(std::memory_order_acquire)) return *s;
+		return detail::create<S>();
+	}
+
+	template <typename S>
+	bool created() {
+		return detail::slot<S>::instance.load(std::memory_order_acquire) != nullptr;
+	}
+
+	/*
+	define<S, Dependencies...>(factory) - factory(Dependencies &...) returns std::unique_ptr<S>.
+	Dependencies have to be defined first, so there are no cycles.
+	*/
+	template <typename S, typename... Dependencies, typename F>
+	void define(F factory, startup when = startup::eager) {
+		if (detail::slot<S>::defined) throw std::logic_error("Service " + detail::name<S>() + " is already defined");
+
+		std::unique_ptr<detail::definition> d(new detail::definition);
+		d->name = detail::name<S>();
+		d->when = when;
+		d->dependencies = { detail::slot<Dependencies>::defined... };
+		if (std::find(d->dependencies.begin(), d->dependencies.end(), nullptr) != d->dependencies.end()) {
+			throw std::logic_error("Service " + d->name + " depends on one that is not defined yet");
+		}
+		d->construct = [factory] {
+			std::unique_ptr<S> s = factory(get<Dependencies>()...);
+			detail::slot<S>::instance.store(s.release(), std::memory_order_release);
+		};
+		d->destroy = [] { delete detail::slot<S>::instance.exchange(nullptr); };
+		detail::slot<S>::defined = &detail::registry::instance().add(std::move(d));
+	}
+
+	/* creates the eager services, threads of them at a time */
+	inline void start(unsigned threads = std::max(1u, std::thread::hardware_concurrency())) {
+		detail::registry::instance().start(threads);
+	}
+
+	/* one line per created service, in order of creation */
+	inline void report(std::ostream &out) {
+		detail::registry::instance().report(out);
+	}
+
+	/* destroys the services in reverse order of creation, they are not created again */
+	inline void shutdown() {
+		detail::registry::instance().shutdown();
+	}
+} // services
+
+
 struct A {
-	static A* obj;
-	static A* getObj() {
-		return A::obj;
+	/* defined in main like any other service */
+	static hot_swappable<A>::reference getObj() {
+		return services::get<hot_swappable<A>>().get();
 	}
 
+	virtual ~A() = default;
 	virtual int vcheck() { return 1; }
 };
 
@@ -22,19 +462,197 @@ struct C: B {
 };
 
 
-A* A::obj = nullptr;
+#ifndef GLOBAL_VIRTUAL_OBJ_BENCHMARK
+
+/* counts the live instances, for checking that swapped out objects are deleted */
+struct D: C {
+	static std::atomic<int> alive;
+	D() { ++alive; }
+	~D() { --alive; }
+};
 
+std::atomic<int> D::alive { 0 };
+
+/* services the process needs before doing anything, each one slow to set up */
+struct configuration {
+	int workers;
+	configuration() { std::this_thread::sleep_for(std::chrono::milliseconds(20)); workers = 4; }
+};
+
+struct database {
+	configuration &config;
+	database(configuration &config): config(config) { std::this_thread::sleep_for(std::chrono::milliseconds(20)); }
+};
+
+struct template_cache {
+	template_cache() { std::this_thread::sleep_for(std::chrono::milliseconds(20)); }
+};
+
+struct request_handler {
+	database &db;
+	template_cache &templates;
+	request_handler(database &db, template_cache &templates): db(db), templates(templates) {}
+};
+
+/* rarely used, only created when asked for */
+struct report_generator {
+	database &db;
+	report_generator(database &db): db(db) {}
+};
+
+/* lazy too, the request_handler factory asks for it while start() is running */
+struct session_store {};
 
 int main() {
 	/* init global AND hold alias pointer to use non-virtual functions of C */
-	/* this is not really good, just a proof-of-concept for legacy code */
+	/* this is not really good, just a proof-of-concept for legacy code - the alias is only valid until the next publish */
 	C* c = new C();
-	A::obj = c;
+	services::define<hot_swappable<A>>([c] { return std::unique_ptr<hot_swappable<A>>(new hot_swappable<A>(unique_ptr<A>(c))); });
+	services::define<configuration>([] { return std::unique_ptr<configuration>(new configuration()); });
+	services::define<database, configuration>([](configuration &config) { return std::unique_ptr<database>(new database(config)); });
+	services::define<template_cache>([] { return std::unique_ptr<template_cache>(new template_cache()); });
+	services::define<request_handler, database, template_cache>([](database &db, template_cache &templates) {
+		services::get<session_store>();
+		return std::unique_ptr<request_handler>(new request_handler(db, templates));
+	});
+	services::define<report_generator, database>([](database &db) { return std::unique_ptr<report_generator>(new report_generator(db)); }, services::startup::lazy);
+	services::define<session_store>([] { return std::unique_ptr<session_store>(new session_store()); }, services::startup::lazy);
+
+	/* configuration and template_cache are created side by side, database as soon as configuration is there */
+	services::start(4);
+	assert(services::created<request_handler>() && !services::created<report_generator>());
+	assert(&services::get<request_handler>().db == &services::get<database>());
+	assert(services::get<report_generator>().db.config.workers == 4 && services::created<report_generator>());
+	std::stringstream report;
+	services::report(report);
+	std::cout << report.str();
+	assert(report.str().find("request_handler: startup") != std::string::npos);
+	assert(report.str().find("session_store: lazy") != std::string::npos && report.str().find("report_generator: lazy") != std::string::npos);
 
 	assert(A::getObj()->vcheck() == 3);
 	assert(B::getObj()->vcheck() == 3);
 	assert(C::getObj()->vcheck() == 3);
 	assert(c->rcheck() == 3);
 
+	/* replaced while other threads are calling it, every swapped out object is deleted */
+	std::atomic<bool> stop { false };
+	std::atomic<long> bad_reads { 0 };
+	std::vector<std::thread> readers;
+	for (int t = 0; t < 4; ++t) {
+		readers.emplace_back([&] {
+			while (!stop.load(std::memory_order_relaxed)) {
+				int v = A::getObj()->vcheck();
+				if (v != 2 && v != 3) ++bad_reads;
+			}
+		});
+	}
+	for (int i = 0; i < 1000; ++i) {
+		if (i % 2) services::get<hot_swappable<A>>().publish(unique_ptr<A>(new B()));
+		else services::get<hot_swappable<A>>().publish(unique_ptr<A>(new D()));
+	}
+	stop = true;
+	for (auto &t: readers) t.join();
+	epoch::domain::instance().synchronize();
+
+	assert(bad_reads == 0);
+	assert(A::getObj()->vcheck() == 2 && D::alive == 0);
+
+	services::get<hot_swappable<A>>().publish(unique_ptr<A>(new D()));
+	assert(A::getObj()->vcheck() == 3 && D::alive == 1);
+
+	services::shutdown();
+	assert(D::alive == 0);
+
+	return 0;
+}
+
+#else // GLOBAL_VIRTUAL_OBJ_BENCHMARK - build with optimizations
+
+#include <chrono>
+
+/* what the readers would do without hot_swappable - serialized on a mutex */
+struct locked_global {
+	std::mutex m;
+	std::shared_ptr<A> obj;
+	std::shared_ptr<A> get() { std::lock_guard<std::mutex> lock(m); return obj; }
+	void publish(std::shared_ptr<A> o) { std::lock_guard<std::mutex> lock(m); obj = std::move(o); }
+};
+
+/* readers call for duration while one writer swaps the object every swap_every, prints reads per second */
+template <typename Read, typename Publish>
+void bench(const char* name, unsigned threads, Read read, Publish publish) {
+	const auto duration = std::chrono::milliseconds(300);
+	const auto swap_every = std::chrono::microseconds(100);
+
+	std::atomic<bool> stop { false };
+	std::atomic<long> reads { 0 };
+	long swaps = 0;
+	std::vector<std::thread> readers;
+	for (unsigned t = 0; t < threads; ++t) {
+		readers.emplace_back([&] {
+			long n = 0, sum = 0;
+			while (!stop.load(std::memory_order_relaxed)) {
+				for (int k = 0; k < 1024; ++k) {
+					sum += read();
+					asm volatile("" : "+r"(sum));
+				}
+				n += 1024;
+			}
+			reads += n;
+		});
+	}
+
+	auto start = std::chrono::steady_clock::now();
+	while (std::chrono::steady_clock::now() - start < duration) {
+		publish(swaps++);
+		std::this_thread::sleep_for(swap_every);
+	}
+	stop = true;
+	for (auto &t: readers) t.join();
+	std::chrono::duration<double> took = std::chrono::steady_clock::now() - start;
+
+	std::cout << name << ", " << threads << " readers: " << reads / took.count() / 1e6 << " M reads/s ("
+	          << reads / took.count() / threads / 1e6 << " M per reader), " << swaps << " swaps" << std::endl;
+}
+
+struct configuration {
+	int workers = 4;
+};
+
+int main() {
+	services::define<hot_swappable<A>>([] { return std::unique_ptr<hot_swappable<A>>(new hot_swappable<A>(unique_ptr<A>(new C()))); });
+	services::define<configuration>([] { return std::unique_ptr<configuration>(new configuration()); });
+	services::start();
+
+	/* a lookup after startup against a plain global */
+	static configuration plain;
+	configuration *volatile plain_global = &plain;
+	const long n = 200000000;
+	for (int k = 0; k < 2; ++k) {
+		auto start = std::chrono::steady_clock::now();
+		long sum = 0;
+		for (long i = 0; i < n; ++i) {
+			sum += k? services::get<configuration>().workers : plain_global->workers;
+			asm volatile("" : "+r"(sum));
+		}
+		std::chrono::duration<double, std::nano> took = std::chrono::steady_clock::now() - start;
+		std::cout << (k? "services::get" : "plain global") << ": " << took.count() / n << " ns/lookup" << std::endl;
+	}
+
+	locked_global locked;
+	locked.publish(std::make_shared<C>());
+
+	auto hw = std::max(1u, std::thread::hardware_concurrency());
+	for (unsigned threads: { 1u, 2u, 4u, hw, 2 * hw }) {
+		bench("hot_swappable", threads,
+			[] { return A::getObj()->vcheck(); },
+			[](long i) { services::get<hot_swappable<A>>().publish(i % 2? unique_ptr<A>(new B()) : unique_ptr<A>(new C())); });
+		bench("mutex + shared_ptr", threads,
+			[&] { return locked.get()->vcheck(); },
+			[&](long i) { locked.publish(i % 2? std::shared_ptr<A>(std::make_shared<B>()) : std::shared_ptr<A>(std::make_shared<C>())); });
+	}
+
 	return 0;
 }
+
+#endif
@@ -1,5 +1,307 @@
 #include <functional>
 #include <type_traits>
+#include <utility>
+
+/*
+Per-method call instrumentation - counts and latency histograms keyed by (member pointer type, member pointer).
+Probes are compiled in only with INTERFACE_WRAPPER_INSTRUMENTATION defined, otherwise call_probe is an empty struct.
+Every thread records into its own counters (no shared writes on the call path), snapshot() / dump_*() merge them on demand.
+*/
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <cstdlib>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <typeinfo>
+#include <vector>
+#include <cxxabi.h>
+#include <thread>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+namespace instrumentation {
+	static constexpr std::size_t histogram_buckets = 32; // bucket b counts calls taking [2^(b-1), 2^b) ticks
+
+	// Probes record raw ticks (TSC where available), conversion to ns happens only in snapshot()
+	struct clock {
+		static std::uint64_t ticks() {
+#if defined(__x86_64__) || defined(__i386__)
+			return __rdtsc();
+#else
+			return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+		}
+
+		static double ns_per_tick() {
+#if defined(__x86_64__) || defined(__i386__)
+			static const double calibrated = [] {
+				auto start = std::chrono::steady_clock::now();
+				auto t0 = ticks();
+				std::this_thread::sleep_for(std::chrono::milliseconds(20));
+				auto t1 = ticks();
+				std::chrono::duration<double, std::nano> took = std::chrono::steady_clock::now() - start;
+				return took.count() / double(t1 - t0);
+			}();
+			return calibrated;
+#else
+			return 1.0;
+#endif
+		}
+	};
+
+	struct method_key {
+		const std::type_info* type; // of the member pointer
+		unsigned char bytes[16];    // of the member pointer
+
+		bool operator==(const method_key& other) const { return *type == *other.type && std::memcmp(bytes, other.bytes, sizeof(bytes)) == 0; }
+		bool operator<(const method_key& other) const {
+			if (*type != *other.type) return type->before(*other.type);
+			return std::memcmp(bytes, other.bytes, sizeof(bytes)) < 0;
+		}
+	};
+
+	template <typename PMF>
+	method_key key_of(PMF func) {
+		static_assert(sizeof(PMF) <= sizeof(method_key::bytes), "Unsupported member pointer representation");
+		method_key key { &typeid(PMF), {} };
+		std::memcpy(key.bytes, &func, sizeof(PMF));
+		return key;
+	}
+
+	struct method_stats {
+		std::string name;
+		std::uint64_t calls = 0;
+		double total_ns = 0;
+		double max_ns = 0;
+		double ns_per_tick = 1.0;
+		std::uint64_t histogram[histogram_buckets] = {}; // in ticks, see histogram_buckets
+
+		double mean_ns() const { return calls? total_ns / calls : 0.0; }
+
+		// upper bound of the bucket containing the given quantile
+		double quantile_ns(double q) const {
+			std::uint64_t seen = 0;
+			for (std::size_t b = 0; b < histogram_buckets; ++b) {
+				seen += histogram[b];
+				if (seen > 0 && seen >= q * calls) return std::min(double(std::uint64_t(1) << b) * ns_per_tick, max_ns);
+			}
+			return max_ns;
+		}
+	};
+
+	namespace detail {
+		// single writer (the owning thread), relaxed atomics only so that snapshot() can read concurrently
+		struct method_counters {
+			explicit method_counters(const method_key& key): key(key) {}
+
+			void record(std::uint64_t ticks) {
+				bump(calls, 1);
+				bump(total_ticks, ticks);
+				if (ticks > max_ticks.load(std::memory_order_relaxed)) max_ticks.store(ticks, std::memory_order_relaxed);
+				std::size_t b = ticks? 64 - __builtin_clzll(ticks) : 0;
+				bump(histogram[b < histogram_buckets? b : histogram_buckets - 1], 1);
+			}
+
+			method_key key;
+			std::atomic<std::uint64_t> calls { 0 };
+			std::atomic<std::uint64_t> total_ticks { 0 };
+			std::atomic<std::uint64_t> max_ticks { 0 };
+			std::atomic<std::uint64_t> histogram[histogram_buckets] = {};
+
+		private:
+			static void bump(std::atomic<std::uint64_t>& c, std::uint64_t by) {
+				c.store(c.load(std::memory_order_relaxed) + by, std::memory_order_relaxed);
+			}
+		};
+
+		struct thread_counters {
+			std::mutex mutex; // guards the deque structure (new methods), not the counters
+			std::deque<method_counters> methods;
+		};
+
+		struct registry {
+			std::mutex mutex;
+			std::vector<std::shared_ptr<thread_counters>> threads; // kept after thread exit
+			std::map<method_key, std::string> names;
+
+			static registry& instance() {
+				static registry r;
+				return r;
+			}
+		};
+
+		// open addressing, key -> this thread's counters
+		struct thread_table {
+			thread_table(): counters(std::make_shared<thread_counters>()), slots(16) {
+				auto& r = registry::instance();
+				std::lock_guard<std::mutex> lock(r.mutex);
+				r.threads.push_back(counters);
+			}
+
+			method_counters& find(const method_key& key) {
+				if (last && last->key == key) return *last; // hot loops keep calling the same method
+				return *(last = &lookup(key));
+			}
+
+		private:
+			method_counters& lookup(const method_key& key) {
+				std::size_t mask = slots.size() - 1;
+				for (std::size_t i = hash(key) & mask;; i = (i + 1) & mask) {
+					if (!slots[i]) return insert(key);
+					if (slots[i]->key == key) return *slots[i];
+				}
+			}
+
+			static std::size_t hash(const method_key& key) {
+				std::uint64_t h = reinterpret_cast<std::uintptr_t>(key.type);
+				std::uint64_t words[2];
+				std::memcpy(words, key.bytes, sizeof(words));
+				h ^= words[0] * 0x9E3779B97F4A7C15ull;
+				h ^= words[1] * 0xC2B2AE3D27D4EB4Full;
+				return static_cast<std::size_t>(h ^ (h >> 29));
+			}
+
+			method_counters& insert(const method_key& key) {
+				method_counters* mc;
+				{
+					std::lock_guard<std::mutex> lock(counters->mutex);
+					counters->methods.emplace_back(key);
+					mc = &counters->methods.back();
+				}
+				if (2 * (++used) > slots.size()) {
+					std::vector<method_counters*> old(slots.size() * 2);
+					old.swap(slots);
+					for (auto s: old) if (s) place(s);
+				}
+				place(mc);
+				return *mc;
+			}
+
+			void place(method_counters* mc) {
+				std::size_t mask = slots.size() - 1;
+				std::size_t i = hash(mc->key) & mask;
+				while (slots[i]) i = (i + 1) & mask;
+				slots[i] = mc;
+			}
+
+			std::shared_ptr<thread_counters> counters;
+			std::vector<method_counters*> slots;
+			std::size_t used = 0;
+			method_counters* last = nullptr;
+		};
+
+		inline method_counters& counters_for(const method_key& key) {
+			static thread_local thread_table table;
+			return table.find(key);
+		}
+
+		inline std::string demangle(const char* name) {
+			int status = 0;
+			char* d = abi::__cxa_demangle(name, nullptr, nullptr, &status);
+			std::string result = status == 0? d : name;
+			std::free(d);
+			return result;
+		}
+	} // detail
+
+	// Readable name used in dumps, by default it is the demangled member pointer type and its bytes
+	template <typename PMF>
+	void name(PMF func, std::string name) {
+		auto& r = detail::registry::instance();
+		std::lock_guard<std::mutex> lock(r.mutex);
+		r.names[key_of(func)] = std::move(name);
+	}
+
+	inline std::vector<method_stats> snapshot() {
+		auto& r = detail::registry::instance();
+		std::lock_guard<std::mutex> lock(r.mutex);
+
+		const double ns_per_tick = clock::ns_per_tick();
+		std::map<method_key, method_stats> merged;
+		for (auto& t: r.threads) {
+			std::lock_guard<std::mutex> thread_lock(t->mutex);
+			for (auto& mc: t->methods) {
+				auto& m = merged[mc.key];
+				m.ns_per_tick = ns_per_tick;
+				m.calls += mc.calls.load(std::memory_order_relaxed);
+				m.total_ns += mc.total_ticks.load(std::memory_order_relaxed) * ns_per_tick;
+				m.max_ns = std::max(m.max_ns, mc.max_ticks.load(std::memory_order_relaxed) * ns_per_tick);
+				for (std::size_t b = 0; b < histogram_buckets; ++b) m.histogram[b] += mc.histogram[b].load(std::memory_order_relaxed);
+			}
+		}
+
+		std::vector<method_stats> result;
+		for (auto& m: merged) {
+			auto named = r.names.find(m.first);
+			if (named != r.names.end()) {
+				m.second.name = named->second;
+			} else {
+				static const char hex[] = "0123456789abcdef";
+				m.second.name = detail::demangle(m.first.type->name()) + " @";
+				for (auto byte: m.first.bytes) { m.second.name += hex[byte >> 4]; m.second.name += hex[byte & 15]; }
+			}
+			result.push_back(std::move(m.second));
+		}
+		return result;
+	}
+
+	inline void dump_text(std::ostream& out) {
+		for (const auto& m: snapshot()) {
+			out << m.name << ": calls=" << m.calls << " mean=" << m.mean_ns() << "ns p50<=" << m.quantile_ns(0.5)
+			    << "ns p99<=" << m.quantile_ns(0.99) << "ns max=" << m.max_ns << "ns\n";
+		}
+	}
+
+	inline void dump_json(std::ostream& out) {
+		out << '[';
+		bool first = true;
+		for (const auto& m: snapshot()) {
+			if (!first) out << ',';
+			first = false;
+			out << "{\"method\":\"";
+			for (char c: m.name) {
+				if (c == '"' || c == '\\') out << '\\';
+				out << c;
+			}
+			out << "\",\"calls\":" << m.calls << ",\"total_ns\":" << m.total_ns << ",\"mean_ns\":" << m.mean_ns()
+			    << ",\"p50_ns\":" << m.quantile_ns(0.5) << ",\"p99_ns\":" << m.quantile_ns(0.99) << ",\"max_ns\":" << m.max_ns
+			    << ",\"histogram\":[";
+			for (std::size_t b = 0; b < histogram_buckets; ++b) out << (b? "," : "") << m.histogram[b];
+			out << "]}";
+		}
+		out << "]\n";
+	}
+
+#ifdef INTERFACE_WRAPPER_INSTRUMENTATION
+	// Times its own lifetime and records it for func
+	struct call_probe {
+		template <typename PMF>
+		explicit call_probe(PMF func): counters(detail::counters_for(key_of(func))), start(clock::ticks()) {}
+
+		~call_probe() { counters.record(clock::ticks() - start); }
+
+		call_probe(const call_probe&) = delete;
+		call_probe& operator=(const call_probe&) = delete;
+
+	private:
+		detail::method_counters& counters;
+		std::uint64_t start;
+	};
+#else
+	struct call_probe {
+		template <typename PMF>
+		explicit call_probe(PMF) {}
+	};
+#endif
+} // instrumentation
 
 namespace detail {
     template <typename... ts>
@@ -15,6 +317,15 @@ namespace detail {
         static const bool value = t::value;
     };
 
+    template <typename... ts>
+    struct all_true {
+        static const bool value = !any_true<std::integral_constant<bool, !ts::value>...>::value;
+    };
+
+	template <typename t, typename... ts> struct index_of;
+	template <typename t, typename... ts> struct index_of<t, t, ts...>: std::integral_constant<std::size_t, 0> {};
+	template <typename t, typename u, typename... ts> struct index_of<t, u, ts...>: std::integral_constant<std::size_t, 1 + index_of<t, ts...>::value> {};
+
 	template<typename> struct type_eraser { using type = int; };
 	template<typename t, typename... ts> struct type_getter { using type = t; };
 
@@ -41,6 +352,19 @@ namespace detail {
 
 	struct multi_wrapper_trait {};
 
+	// Non-owning, non-allocating callable bound to an implementation and one of its member functions
+	template <typename interface, typename RV, typename... Args>
+	struct bound_call {
+		interface* _impl;
+		RV (interface::*_func)(Args...);
+
+		template <typename... As>
+		RV operator()(As&&... args) const {
+			instrumentation::call_probe probe(_func);
+			return (_impl->*_func)(std::forward<As>(args)...);
+		}
+	};
+
 } // detail
 
 template <typename interface>
@@ -55,24 +379,158 @@ public:
     interface* operator->() { return _impl; }
     const interface* const operator->() const { return _impl; }
 
-	template <typename RV, typename... Args>
-	typename std::enable_if<!std::is_base_of<detail::multi_wrapper_trait, interface>::value, std::function<RV(Args...)>>::type
-	call(RV (interface::*func)(Args...)) {
-		return [this, func](Args... args) { (_impl->*func)(args...); };
+	// hot path - no type erasure, the call is resolved statically down to the member pointer
+	template <typename RV, typename IT, typename... Args, typename... As, typename I = interface>
+	typename std::enable_if<!std::is_base_of<detail::multi_wrapper_trait, I>::value, RV>::type
+	invoke(RV (IT::*func)(Args...), As&&... args) {
+		instrumentation::call_probe probe(func);
+		return (_impl->*func)(std::forward<As>(args)...);
+	}
+
+	template <typename RV, typename IT, typename... Args, typename... As, typename I = interface>
+	typename std::enable_if<std::is_base_of<detail::multi_wrapper_trait, I>::value, void>::type
+	invoke(RV (IT::*func)(Args...), As&&... args) {
+		_impl->operator[](func)(std::forward<As>(args)...);
 	}
 
 	template <typename RV, typename... Args>
-	typename std::enable_if<std::is_base_of<detail::multi_wrapper_trait, interface>::value, std::function<RV(Args...)>>::type
+	typename std::enable_if<!std::is_base_of<detail::multi_wrapper_trait, interface>::value, detail::bound_call<interface, RV, Args...>>::type
 	call(RV (interface::*func)(Args...)) {
-		return [this, func](Args... args) { return _impl->operator[](func); };
+		return { _impl, func };
+	}
+
+	template <typename RV, typename IT, typename... Args, typename I = interface>
+	typename std::enable_if<std::is_base_of<detail::multi_wrapper_trait, I>::value, typename I::template broadcast_call<RV, IT, Args...>>::type
+	call(RV (IT::*func)(Args...)) {
+		return _impl->operator[](func);
 	}
 };
 
 #include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <future>
+#include <tuple>
+#include <algorithm>
+#include <memory>
+#include <exception>
+
+struct thread_pool {
+	explicit thread_pool(std::size_t threads = std::max(1u, std::thread::hardware_concurrency())) {
+		for (std::size_t i = 0; i < threads; ++i) {
+			workers.emplace_back([this] { run(); });
+		}
+	}
+
+	thread_pool(const thread_pool&) = delete;
+	thread_pool& operator=(const thread_pool&) = delete;
+
+	~thread_pool() {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+		cv.notify_all();
+		for (auto& w: workers) w.join();
+	}
+
+	void post(std::function<void()> task) {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			tasks.push_back(std::move(task));
+		}
+		cv.notify_one();
+	}
+
+private:
+	void run() {
+		for (;;) {
+			std::function<void()> task;
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				cv.wait(lock, [this] { return stopping || !tasks.empty(); });
+				if (tasks.empty()) return; // only when stopping - queued work is drained first
+				task = std::move(tasks.front());
+				tasks.pop_front();
+			}
+			task();
+		}
+	}
+
+	std::vector<std::thread> workers;
+	std::deque<std::function<void()>> tasks;
+	std::mutex mutex;
+	std::condition_variable cv;
+	bool stopping = false;
+};
+
+// Order of the results handed back by a parallel broadcast
+enum class result_order {
+	registration, // same order as the implementations were registered in
+	completion,   // as the handlers finished
+};
+
+namespace detail {
+	// Parameters a parallel broadcast can pass one shared copy of the arguments to - no handler can modify it
+	template <typename T>
+	struct shared_parameter: std::integral_constant<bool, !std::is_reference<T>::value || std::is_const<std::remove_reference_t<T>>::value> {};
+
+	template <typename T, typename RV, typename IT, typename... Args, typename Tuple, std::size_t... I>
+	RV apply_member(T* impl, RV (IT::*func)(Args...), Tuple& args, std::index_sequence<I...>) {
+		return (impl->*func)(std::get<I>(args)...);
+	}
+
+	// Collects results of one parallel broadcast, the last handler to finish fulfills the promise
+	template <typename RV, typename Result>
+	struct fanout_state {
+		fanout_state(std::size_t n, result_order order, std::function<Result(std::vector<RV>&&)> finish):
+			remaining(n), order(order), finish(std::move(finish)) { results.reserve(n); }
+
+		void complete(std::size_t index, RV&& value) {
+			std::lock_guard<std::mutex> lock(mutex);
+			results.emplace_back(index, std::move(value));
+			if (--remaining == 0) fulfill();
+		}
+
+		void fail(std::exception_ptr e) {
+			std::lock_guard<std::mutex> lock(mutex);
+			if (!error) error = e;
+			if (--remaining == 0) fulfill();
+		}
+
+		std::promise<Result> promise;
+
+	private:
+		void fulfill() {
+			if (error) return promise.set_exception(error);
+			if (order == result_order::registration) {
+				std::sort(results.begin(), results.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+			}
+			std::vector<RV> values;
+			values.reserve(results.size());
+			for (auto& r: results) values.push_back(std::move(r.second));
+			try {
+				promise.set_value(finish(std::move(values)));
+			} catch (...) {
+				promise.set_exception(std::current_exception());
+			}
+		}
+
+		std::mutex mutex;
+		std::vector<std::pair<std::size_t, RV>> results;
+		std::size_t remaining;
+		result_order order;
+		std::exception_ptr error;
+		std::function<Result(std::vector<RV>&&)> finish;
+	};
+} // detail
+
 template <typename IF>
 struct multi_interface: IF, detail::multi_wrapper_trait {
 	template <typename... cts>
-	multi_interface(cts*... args): ifs(args...) {}
+	multi_interface(cts*... args): ifs{ args... } {}
 
 	template <typename... cts>
 	struct concrete_creator {
@@ -82,22 +540,367 @@ struct multi_interface: IF, detail::multi_wrapper_trait {
 		}
 	};
 
+	// Return values of the implementations are discarded
+	template <typename RV, typename IT, typename... Args>
+	struct broadcast_call {
+		const multi_interface* _multi;
+		RV (IT::*_func)(Args...);
+
+		template <typename... As>
+		void operator()(As&&... args) const {
+			instrumentation::call_probe probe(_func); // the whole broadcast
+			// no forwarding - every implementation gets the same arguments
+			for (auto i: _multi->ifs) {
+				(i->*_func)(args...);
+			}
+		}
+	};
+
 	template <typename RV, typename IT, typename... Args>
-	auto operator[](RV (IT::*func)(Args...)) -> std::function<RV(Args...)> {
+	auto operator[](RV (IT::*func)(Args...)) const -> broadcast_call<RV, IT, Args...> {
 		// The interface better not be deleted!
 		// we cannot afford passing the vector by value every time
-		return [this, func](Args... args) {
-			for (auto i: ifs) {
-				(i->*func)(args...);
+		return { this, func };
+	}
+
+	// Runs every implementation on the pool, the future is ready once the slowest one finishes
+	template <typename RV, typename IT, typename... Args>
+	struct parallel_call {
+		const multi_interface* _multi;
+		RV (IT::*_func)(Args...);
+		thread_pool* _pool;
+		result_order _order;
+
+		template <typename... As>
+		std::future<std::vector<RV>> operator()(As&&... args) const {
+			return reduce([](std::vector<RV>&& results) { return std::move(results); }, std::forward<As>(args)...);
+		}
+
+		// reducer gets all of the results (ordered according to _order) as std::vector<RV>&&
+		template <typename Reducer, typename... As>
+		auto reduce(Reducer reducer, As&&... args) const -> std::future<decltype(reducer(std::declval<std::vector<RV>&&>()))> {
+			using Result = decltype(reducer(std::declval<std::vector<RV>&&>()));
+			static_assert(!std::is_void<RV>::value, "Use the sequential operator[] for functions returning void");
+			static_assert(detail::all_true<std::true_type, detail::shared_parameter<Args>...>::value,
+			              "Handlers running in parallel share the arguments, parameters have to be values or const references");
+
+			const auto& ifs = _multi->ifs;
+			if (ifs.empty()) {
+				std::promise<Result> done;
+				done.set_value(reducer(std::vector<RV>{}));
+				return done.get_future();
 			}
+
+			auto state = std::make_shared<detail::fanout_state<RV, Result>>(ifs.size(), _order, std::move(reducer));
+			auto future = state->promise.get_future();
+
+			// arguments are copied once and shared by all of the handlers, read-only
+			auto shared_args = std::make_shared<const std::tuple<std::decay_t<As>...>>(std::forward<As>(args)...);
+			for (std::size_t index = 0; index < ifs.size(); ++index) {
+				auto impl = ifs[index];
+				auto func = _func;
+				_pool->post([state, shared_args, impl, func, index] {
+					try {
+						state->complete(index, detail::apply_member(impl, func, *shared_args, std::index_sequence_for<As...>{}));
+					} catch (...) {
+						state->fail(std::current_exception());
+					}
+				});
+			}
+			return future;
+		}
+	};
+
+	template <typename RV, typename IT, typename... Args>
+	auto parallel(thread_pool& pool, RV (IT::*func)(Args...), result_order order = result_order::registration) const -> parallel_call<RV, IT, Args...> {
+		// same as operator[] - the interface has to outlive the returned futures
+		return { this, func, &pool, order };
+	}
+
+protected:
+	std::vector<IF*> ifs;
+};
+
+
+#include <atomic>
+#include <cstddef>
+#include <new>
+#include <chrono>
+#include <stdexcept>
+
+namespace detail {
+	// Bounded lock-free MPMC ring (Vyukov), calls are constructed and run in place - no allocation per call
+	template <typename IF, std::size_t PayloadSize>
+	struct call_queue {
+		explicit call_queue(std::size_t capacity): mask(capacity - 1), cells(new cell[capacity]) {
+			if (capacity < 2 || (capacity & mask) != 0) throw std::invalid_argument("call_queue capacity has to be a power of two");
+			for (std::size_t i = 0; i < capacity; ++i) cells[i].sequence.store(i, std::memory_order_relaxed);
+		}
+
+		~call_queue() {
+			while (pop(nullptr)) {}
+		}
+
+		// The slot is claimed before the payload is moved into it, a throwing move would leave it unpublished for good
+		template <typename P>
+		bool try_push(P&& payload) {
+			static_assert(!std::is_reference<P>::value, "Payloads are moved into the queue");
+			static_assert(std::is_nothrow_move_constructible<P>::value, "Call arguments have to be nothrow move constructible");
+			static_assert(sizeof(P) <= PayloadSize && alignof(P) <= alignof(std::max_align_t), "Call arguments do not fit in a queue slot");
+
+			cell* c;
+			std::size_t pos = enqueue_pos.load(std::memory_order_relaxed);
+			for (;;) {
+				c = &cells[pos & mask];
+				std::size_t seq = c->sequence.load(std::memory_order_acquire);
+				auto diff = static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(pos);
+				if (diff == 0) {
+					if (enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+				} else if (diff < 0) {
+					return false; // full
+				} else {
+					pos = enqueue_pos.load(std::memory_order_relaxed);
+				}
+			}
+
+			::new (static_cast<void*>(&c->storage)) P(std::move(payload));
+			c->run = [](IF* impl, void* storage) {
+				struct destroy_payload { // the arguments are destroyed even if the handler throws
+					P* p;
+					~destroy_payload() { p->~P(); }
+				} payload { static_cast<P*>(storage) };
+				if (impl) (*payload.p)(impl);
+			};
+			c->sequence.store(pos + 1, std::memory_order_release);
+			return true;
+		}
+
+		// Runs the oldest call on impl (or just discards it when impl is null)
+		bool pop(IF* impl) {
+			cell* c;
+			std::size_t pos = dequeue_pos.load(std::memory_order_relaxed);
+			for (;;) {
+				c = &cells[pos & mask];
+				std::size_t seq = c->sequence.load(std::memory_order_acquire);
+				auto diff = static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(pos + 1);
+				if (diff == 0) {
+					if (dequeue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+				} else if (diff < 0) {
+					return false; // empty
+				} else {
+					pos = dequeue_pos.load(std::memory_order_relaxed);
+				}
+			}
+
+			struct release_cell { // the slot is handed back even if the handler throws
+				cell* c; std::size_t next;
+				~release_cell() { c->sequence.store(next, std::memory_order_release); }
+			} release { c, pos + mask + 1 };
+			c->run(impl, &c->storage);
+			return true;
+		}
+
+	private:
+		struct cell {
+			std::atomic<std::size_t> sequence;
+			void (*run)(IF*, void*);
+			typename std::aligned_storage<PayloadSize, alignof(std::max_align_t)>::type storage;
+		};
+
+		const std::size_t mask;
+		std::unique_ptr<cell[]> cells;
+		// padded rather than alignas(64) - C++14 operator new does not honour extended alignment
+		char pad0[64];
+		std::atomic<std::size_t> enqueue_pos { 0 };
+		char pad1[64];
+		std::atomic<std::size_t> dequeue_pos { 0 };
+	};
+
+	template <typename Func, typename... Ds>
+	struct pending_call {
+		Func func;
+		std::tuple<Ds...> args;
+
+		template <typename T>
+		void operator()(T* impl) { apply_member(impl, func, args, std::index_sequence_for<Ds...>{}); }
+	};
+} // detail
+
+// What publishing does when a subscriber's queue is full
+enum class overflow_policy {
+	drop_newest, // the published call is discarded for that subscriber
+	drop_oldest, // the oldest pending call is evicted to make room
+	block,       // the publisher spins until the subscriber catches up
+};
+
+struct async_options {
+	std::size_t capacity = 1024; // per subscriber, power of two
+	std::size_t batch_size = 64;
+	overflow_policy overflow = overflow_policy::drop_newest;
+	std::chrono::microseconds idle_wait { 50 }; // consumer back-off when its queue is empty
+};
+
+struct subscriber_stats {
+	std::size_t enqueued;
+	std::size_t processed;
+	std::size_t dropped; // rejected and evicted calls
+	std::size_t lag;     // calls waiting in the queue
+	std::size_t max_lag; // highest lag seen by the consumer at the start of a batch
+};
+
+/*
+Event bus mode of multi_interface: post() only enqueues the call for every subscriber,
+each subscriber has its own consumer thread draining its queue in batches.
+Handlers of one subscriber are always called from the same thread, in the published order.
+*/
+template <typename IF, std::size_t PayloadSize = 64>
+struct async_multi_interface: multi_interface<IF> {
+	template <typename... cts>
+	async_multi_interface(async_options options, cts*... args): multi_interface<IF>(args...), options(options) {
+		for (auto impl: this->ifs) {
+			subscribers.emplace_back(new subscriber(impl, options.capacity));
+		}
+		for (auto& sub: subscribers) {
+			sub->consumer = std::thread([this, s = sub.get()] { consume(*s); });
+		}
+	}
+
+	~async_multi_interface() {
+		running.store(false, std::memory_order_release);
+		for (auto& sub: subscribers) sub->consumer.join();
+	}
+
+	// Returns the number of subscribers which accepted the call
+	template <typename RV, typename IT, typename... Args, typename... As>
+	std::size_t post(RV (IT::*func)(Args...), As&&... args) {
+		using call_t = detail::pending_call<RV (IT::*)(Args...), std::decay_t<As>...>;
+		std::size_t accepted = 0;
+		for (auto& sub: subscribers) {
+			if (enqueue(*sub, call_t { func, std::tuple<std::decay_t<As>...>(args...) })) ++accepted;
+		}
+		return accepted;
+	}
+
+	// Waits until every call posted so far has been processed or dropped
+	void flush() const {
+		for (auto& sub: subscribers) {
+			while (sub->lag() != 0) std::this_thread::yield();
+		}
+	}
+
+	subscriber_stats stats(std::size_t index) const {
+		const auto& sub = *subscribers.at(index);
+		return {
+			sub.enqueued.load(std::memory_order_relaxed),
+			sub.processed.load(std::memory_order_relaxed),
+			sub.dropped.load(std::memory_order_relaxed),
+			sub.lag(),
+			sub.max_lag.load(std::memory_order_relaxed)
 		};
 	}
 
 private:
-	std::vector<IF*> ifs;
+	struct subscriber {
+		subscriber(IF* impl, std::size_t capacity): impl(impl), queue(capacity) {}
+
+		// the counters are read one at a time, processed and evicted may have moved past the enqueued read first
+		std::size_t lag() const {
+			std::size_t done = processed.load(std::memory_order_acquire) + evicted.load(std::memory_order_acquire);
+			std::size_t in = enqueued.load(std::memory_order_acquire);
+			return in > done ? in - done : 0;
+		}
+
+		IF* impl;
+		detail::call_queue<IF, PayloadSize> queue;
+		std::thread consumer;
+		char pad0[64]; // publisher and consumer counters on separate cache lines
+		std::atomic<std::size_t> enqueued { 0 };
+		std::atomic<std::size_t> dropped { 0 };
+		std::atomic<std::size_t> evicted { 0 };
+		char pad1[64];
+		std::atomic<std::size_t> processed { 0 };
+		std::atomic<std::size_t> max_lag { 0 };
+	};
+
+	template <typename Call>
+	bool enqueue(subscriber& sub, Call call) {
+		// counted up front so that lag() can only overestimate while the push is in flight
+		sub.enqueued.fetch_add(1, std::memory_order_release);
+		while (!sub.queue.try_push(std::move(call))) { // only moved from once a slot is claimed
+			switch (options.overflow) {
+			case overflow_policy::drop_newest:
+				sub.enqueued.fetch_sub(1, std::memory_order_release);
+				sub.dropped.fetch_add(1, std::memory_order_relaxed);
+				return false;
+			case overflow_policy::drop_oldest:
+				if (sub.queue.pop(nullptr)) {
+					sub.evicted.fetch_add(1, std::memory_order_relaxed);
+					sub.dropped.fetch_add(1, std::memory_order_relaxed);
+				}
+				break;
+			case overflow_policy::block:
+				std::this_thread::yield();
+				break;
+			}
+		}
+		return true;
+	}
+
+	void consume(subscriber& sub) {
+		for (;;) {
+			// read before draining so that everything enqueued before shutdown is still delivered
+			bool stopping = !running.load(std::memory_order_acquire);
+
+			auto lag = sub.lag();
+			if (lag > sub.max_lag.load(std::memory_order_relaxed)) sub.max_lag.store(lag, std::memory_order_relaxed);
+
+			std::size_t n = 0;
+			while (n < options.batch_size) {
+				bool popped;
+				try {
+					popped = sub.queue.pop(sub.impl);
+				} catch (...) {
+					popped = true; // there is nobody to report to, a throwing handler only loses its own call
+				}
+				if (!popped) break;
+				++n;
+			}
+			sub.processed.fetch_add(n, std::memory_order_release);
+
+			if (n == 0) {
+				if (stopping) return;
+				std::this_thread::sleep_for(options.idle_wait);
+			}
+		}
+	}
+
+	async_options options;
+	std::vector<std::unique_ptr<subscriber>> subscribers;
+	std::atomic<bool> running { true };
 };
 
 
+namespace detail {
+	// deletes exactly a T - unlike std::default_delete it does not convert to the deleter of a base
+	template <typename T>
+	struct exact_delete {
+		void operator()(T* p) const { delete p; }
+	};
+
+	template <typename T, typename Alloc>
+	struct allocator_delete {
+		using traits = typename std::allocator_traits<Alloc>::template rebind_traits<T>;
+		typename traits::allocator_type alloc;
+
+		void operator()(T* p) {
+			traits::destroy(alloc, p);
+			traits::deallocate(alloc, p, 1);
+		}
+	};
+} // detail
+
+template <typename wrapper, typename... cts> struct inline_interface_wrapper;
+
 template <typename... ts> // interfaces
 struct interface_wrapper: virtual _interface<ts>... {
     interface_wrapper(ts*... args): _interface<ts>(args)... {}
@@ -109,23 +912,49 @@ struct interface_wrapper: virtual _interface<ts>... {
 		static interface_wrapper<ts...>* create(Args... args) {
 			return new interface_wrapper<ts...>(detail::interface_helper<cts>::create(args...)...);
 		}
+
+		// implementations live inside the wrapper - it can also sit on the stack / be a member, no allocation at all
+		// keeps the concrete types, see inline_interface_wrapper::concrete
+		using inline_type = inline_interface_wrapper<interface_wrapper<ts...>, cts...>;
+
+		// one allocation for the wrapper and all of its implementations
+		// interface_wrapper has no virtual destructor, so the owner cannot be converted to a std::unique_ptr of the base
+		template <typename... Args>
+		static std::unique_ptr<inline_type, detail::exact_delete<inline_type>> create_unique(Args... args) {
+			return std::unique_ptr<inline_type, detail::exact_delete<inline_type>>(new inline_type(args...));
+		}
+
+		// same as create_unique, but the block comes from alloc (e.g. a pool when creating a wrapper per connection)
+		template <typename Alloc, typename... Args>
+		static std::unique_ptr<inline_type, detail::allocator_delete<inline_type, Alloc>> allocate(const Alloc& alloc, Args... args) {
+			using deleter = detail::allocator_delete<inline_type, Alloc>;
+			using traits = typename deleter::traits;
+
+			typename traits::allocator_type a(alloc);
+			inline_type* p = traits::allocate(a, 1);
+			try {
+				traits::construct(a, p, args...);
+			} catch (...) {
+				traits::deallocate(a, p, 1);
+				throw;
+			}
+			return { p, deleter { a } };
+		}
 	};
 
-	template <typename RV, typename IT, typename... Args>
-	auto call(RV (IT::*func)(Args...), Args... args) -> RV {
-		return static_cast<_interface<IT>*>(this)->call(func)(args...);
+	template <typename RV, typename IT, typename... Args, typename... As>
+	auto call(RV (IT::*func)(Args...), As&&... args) -> RV {
+		return static_cast<_interface<IT>*>(this)->invoke(func, std::forward<As>(args)...);
 	}
 
-	template <typename RV, typename IT, typename... Args>
-	auto operator()(RV (IT::*func)(Args...), Args... args) -> RV {
-		return static_cast<_interface<IT>*>(this)->call(func)(args...);
+	template <typename RV, typename IT, typename... Args, typename... As>
+	auto operator()(RV (IT::*func)(Args...), As&&... args) -> RV {
+		return static_cast<_interface<IT>*>(this)->invoke(func, std::forward<As>(args)...);
 	}
 
 	template <typename RV, typename IT, typename... Args>
-	auto operator[](RV (IT::*func)(Args...)) -> std::function<RV(Args...)> {
+	auto operator[](RV (IT::*func)(Args...)) -> detail::bound_call<IT, RV, Args...> {
 		return static_cast<_interface<IT>*>(this)->call(func);
-		//IT* iface = get<IT>().operator->();
-		//return [iface, func](Args... args){ (iface->*func)(args...); };
 	}
 
     template <typename it>
@@ -136,9 +965,65 @@ struct interface_wrapper: virtual _interface<ts>... {
 };
 
 
+namespace detail {
+	// Virtual base of inline_interface_wrapper so that it is constructed before the _interface<ts> bases pointing into it
+	template <typename... cts>
+	struct inline_storage {
+		template <typename Arg, typename... Ignored> // same argument passing as interface_helper
+		inline_storage(Arg arg, Ignored...): impls(static_cast<typename cts::Args>(arg)...) {} // constructed in place
+
+		std::tuple<cts...> impls;
+	};
+} // detail
+
+/*
+interface_wrapper owning its implementations by value - destroyed together with the wrapper.
+The _interface<ts> pointers point into the object itself, so it can be neither copied nor moved.
+
+It is also the "sealed" wrapper: the concrete types are part of its type, so concrete<IT>() / apply<IT>()
+reach the implementation without going through the interface vtable and the calls can be inlined
+(declare the implementations final, otherwise the compiler only speculates on the concrete type).
+Calls through member pointers (call, operator(), operator[]) and the conversion to interface_wrapper<ts...>&
+still dispatch virtually - a member pointer to a virtual function cannot be devirtualized.
+*/
+template <typename... ts, typename... cts>
+struct inline_interface_wrapper<interface_wrapper<ts...>, cts...>: virtual detail::inline_storage<cts...>, interface_wrapper<ts...> {
+	static_assert(sizeof...(ts) == sizeof...(cts), "Every interface needs exactly one implementation");
+	static_assert(detail::all_true<std::is_base_of<ts, cts>...>::value, "Implementation does not derive from its interface");
+
+	template <typename... Args>
+	inline_interface_wrapper(Args... args): inline_interface_wrapper(std::index_sequence_for<cts...>{}, args...) {}
+
+	inline_interface_wrapper(const inline_interface_wrapper&) = delete;
+	inline_interface_wrapper& operator=(const inline_interface_wrapper&) = delete;
+
+	template <typename IT>
+	using concrete_t = typename std::tuple_element<detail::index_of<IT, ts...>::value, std::tuple<cts...>>::type;
+
+	template <typename IT>
+	concrete_t<IT>& concrete() {
+		return std::get<detail::index_of<IT, ts...>::value>(this->impls);
+	}
+
+	// f gets the implementation of IT by its concrete type, e.g. apply<interface1>([](auto& i) { return i.twice(2); })
+	template <typename IT, typename F>
+	auto apply(F&& f) -> decltype(std::forward<F>(f)(std::declval<concrete_t<IT>&>())) {
+		return std::forward<F>(f)(concrete<IT>());
+	}
+
+private:
+	template <std::size_t... I, typename... Args>
+	inline_interface_wrapper(std::index_sequence<I...>, Args... args):
+		detail::inline_storage<cts...>(args...),
+		_interface<ts>(static_cast<ts*>(&std::get<I>(this->impls)))...,
+		interface_wrapper<ts...>(static_cast<ts*>(&std::get<I>(this->impls))...) {}
+};
+
+
 struct interface1 {
 	virtual void test() = 0;
 	virtual void test2(int i) = 0;
+	virtual int twice(int i) = 0;
 };
 
 struct interface2 {
@@ -148,16 +1033,60 @@ struct interface2 {
 
 
 #include <iostream>
+#include <cassert>
+#include <chrono>
+#include <numeric>
 
-struct c_handler1: interface1 {
+struct c_handler1 final: interface1 {
 	using Args = int;
-	c_handler1(int i) {}
+	static int alive;
+	c_handler1(int i) { ++alive; }
+	~c_handler1() { --alive; }
 
 	void test() { std::cout << "Test 1" << std::endl; }
 	void test2(int i) { std::cout << "Test 1 " << i << std::endl; }
+	int twice(int i) { return 2 * i; }
+};
+
+struct worker_interface {
+	virtual ~worker_interface() = default;
+	virtual int work(int i) { return i; }
+};
+
+struct c_worker: worker_interface {
+	using Args = int;
+	int delay_ms;
+	c_worker(int delay_ms): delay_ms(delay_ms) {}
+
+	int work(int i) override {
+		std::this_thread::sleep_for(std::chrono::milliseconds(delay_ms));
+		return i + delay_ms;
+	}
 };
 
-struct c_handler2: interface2 {
+// queued arguments have to be destroyed whatever the handler does with them
+struct counted_arg {
+	static std::atomic<int> alive; // copied on the publisher thread, destroyed on the consumer thread
+	counted_arg() { ++alive; }
+	counted_arg(const counted_arg&) { ++alive; }
+	counted_arg(counted_arg&&) noexcept { ++alive; }
+	~counted_arg() { --alive; }
+};
+
+std::atomic<int> counted_arg::alive { 0 };
+
+struct arg_interface {
+	virtual ~arg_interface() = default;
+	virtual void take(counted_arg) {}
+};
+
+struct c_throwing: arg_interface {
+	using Args = int;
+	c_throwing(int) {}
+	void take(counted_arg) override { throw std::runtime_error("handler failed"); }
+};
+
+struct c_handler2 final: interface2 {
 	using Args = double;
 	c_handler2(double d) {}
 
@@ -165,9 +1094,50 @@ struct c_handler2: interface2 {
 	void test2(bool i) { std::cout << "Test 1 " << i << std::endl; }
 };
 
+int c_handler1::alive = 0;
+
+// can be neither copied nor moved, the inline wrapper constructs it in place
+struct c_locked_handler final: interface2 {
+	using Args = double;
+	std::mutex m;
+	c_locked_handler(double) {}
+
+	void test() { std::lock_guard<std::mutex> lock(m); }
+	void test2(bool) {}
+};
+
+// Bump allocator handing out blocks from one buffer, counts the allocations made through it
+struct arena {
+	alignas(std::max_align_t) unsigned char buffer[4096];
+	std::size_t used = 0;
+	std::size_t allocations = 0;
+	std::size_t deallocations = 0;
+};
+
+template <typename T>
+struct arena_allocator {
+	using value_type = T;
+	arena* a;
+
+	arena_allocator(arena* a): a(a) {}
+	template <typename U> arena_allocator(const arena_allocator<U>& other): a(other.a) {}
+
+	T* allocate(std::size_t n) {
+		std::size_t offset = (a->used + alignof(T) - 1) / alignof(T) * alignof(T);
+		if (offset + n * sizeof(T) > sizeof(a->buffer)) throw std::bad_alloc();
+		a->used = offset + n * sizeof(T);
+		++a->allocations;
+		return reinterpret_cast<T*>(a->buffer + offset);
+	}
+
+	void deallocate(T*, std::size_t) { ++a->deallocations; } // memory is only reclaimed with the whole arena
+};
 
 
 
+
+#ifndef INTERFACE_WRAPPER_BENCHMARK
+
 int main() {
 
 	auto i = *interface_wrapper<interface1, interface2>::concrete_creator<c_handler1, c_handler2>::create(3.23, 1);
@@ -181,5 +1151,155 @@ int main() {
 	i[&interface1::test2](4);
 	i[&interface2::test2](true);
 
+	// return values are passed through, arguments are forwarded and converted only at the final call
+	assert(i[&interface1::twice](21) == 42);
+	assert(i(&interface1::twice, 4) == 8);
+	assert(i2.call(&interface1::twice, 'a') == 2 * 'a');
+	i2.call(&interface2::test2, 1);
+
+	// implementations stored inside the wrapper - one allocation in total, destroyed with the wrapper
+	using creator = interface_wrapper<interface1, interface2>::concrete_creator<c_handler1, c_handler2>;
+	int alive_before = c_handler1::alive;
+	{
+		creator::inline_type on_stack(2.5);
+		assert(on_stack(&interface1::twice, 5) == 10);
+
+		auto owned = creator::create_unique(2.5);
+		interface_wrapper<interface1, interface2>& erased = *owned;
+		assert(erased[&interface1::twice](6) == 12);
+		assert(c_handler1::alive == alive_before + 2);
+
+		arena pool;
+		{
+			arena_allocator<char> alloc(&pool);
+			auto w1 = creator::allocate(alloc, 1.0);
+			auto w2 = creator::allocate(alloc, 2.0);
+			assert(w2->call(&interface1::twice, 7) == 14);
+			assert(pool.allocations == 2);
+		}
+		assert(pool.deallocations == 2);
+	}
+	assert(c_handler1::alive == alive_before);
+	static_assert(!std::is_convertible<decltype(creator::create_unique(1.0)), std::unique_ptr<interface_wrapper<interface1, interface2>>>::value,
+		"an inline wrapper must not be deleted through the base");
+	{
+		interface_wrapper<interface2>::concrete_creator<c_locked_handler>::inline_type locked(1.0);
+		locked(&interface2::test);
+	}
+
+	// sealed calls reach the concrete type directly
+	{
+		creator::inline_type sealed(1);
+		assert(sealed.concrete<interface1>().twice(3) == 6);
+		assert(sealed.apply<interface1>([](c_handler1& h) { return h.twice(4); }) == 8);
+		static_assert(std::is_same<creator::inline_type::concrete_t<interface2>, c_handler2>::value, "");
+	}
+
+	// per-method counters - only filled in when built with INTERFACE_WRAPPER_INSTRUMENTATION
+	instrumentation::name(&interface1::twice, "interface1::twice");
+	for (int k = 0; k < 10; ++k) i.call(&interface1::twice, k);
+#ifdef INTERFACE_WRAPPER_INSTRUMENTATION
+	auto stats = instrumentation::snapshot();
+	auto twice_stats = std::find_if(stats.begin(), stats.end(), [](const instrumentation::method_stats& m) { return m.name == "interface1::twice"; });
+	assert(twice_stats != stats.end() && twice_stats->calls >= 10);
+	instrumentation::dump_text(std::cout);
+	instrumentation::dump_json(std::cout);
+#else
+	assert(instrumentation::snapshot().empty());
+#endif
+
+	// parallel broadcast - takes as long as the slowest worker, not the sum of them
+	multi_interface<worker_interface> workers(new c_worker(60), new c_worker(0), new c_worker(30));
+	thread_pool pool(3);
+
+	auto start = std::chrono::steady_clock::now();
+	auto in_order = workers.parallel(pool, &worker_interface::work)(1).get();
+	assert((in_order == std::vector<int>{ 61, 1, 31 }));
+	std::cout << "Parallel broadcast took " << std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count() << "ms (sequential would be 90ms)" << std::endl;
+
+	auto as_finished = workers.parallel(pool, &worker_interface::work, result_order::completion)(1).get();
+	assert(std::is_permutation(as_finished.begin(), as_finished.end(), in_order.begin()));
+
+	auto sum = workers.parallel(pool, &worker_interface::work).reduce(
+		[](std::vector<int>&& r) { return std::accumulate(r.begin(), r.end(), 0); }, 2);
+	assert(sum.get() == 62 + 2 + 32);
+
+	workers[&worker_interface::work](3); // sequential broadcast is still there
+
+	// event bus - post() only enqueues, every subscriber drains its own queue on its own thread
+	{
+		async_options bus_options;
+		bus_options.capacity = 4;
+		bus_options.overflow = overflow_policy::drop_newest;
+		async_multi_interface<worker_interface> bus(bus_options, new c_worker(0), new c_worker(5));
+
+		for (int n = 0; n < 16; ++n) bus.post(&worker_interface::work, n);
+		bus.flush();
+
+		auto fast = bus.stats(0), slow = bus.stats(1);
+		assert(fast.enqueued + fast.dropped == 16 && fast.processed == fast.enqueued && fast.lag == 0);
+		assert(slow.enqueued + slow.dropped == 16 && slow.processed == slow.enqueued && slow.dropped > 0);
+		std::cout << "Slow subscriber dropped " << slow.dropped << " calls, max lag " << slow.max_lag << std::endl;
+	}
+	{
+		async_options bus_options;
+		bus_options.capacity = 2;
+		bus_options.overflow = overflow_policy::block;
+		async_multi_interface<worker_interface> bus(bus_options, new c_worker(1));
+
+		for (int n = 0; n < 8; ++n) bus.post(&worker_interface::work, n);
+		bus.flush();
+		assert(bus.stats(0).processed == 8 && bus.stats(0).dropped == 0);
+	}
+	{
+		async_multi_interface<arg_interface> bus(async_options{}, new c_throwing(0));
+		for (int n = 0; n < 4; ++n) bus.post(&arg_interface::take, counted_arg());
+		bus.flush();
+		assert(bus.stats(0).processed == 4 && counted_arg::alive == 0);
+	}
+
 	return 0;
 }
+
+#else // INTERFACE_WRAPPER_BENCHMARK - build with optimizations
+
+using bench_wrapper = interface_wrapper<interface1, interface2>;
+using bench_creator = bench_wrapper::concrete_creator<c_handler1, c_handler2>;
+
+template <typename F>
+void bench(const char* name, long n, F f) {
+	auto start = std::chrono::steady_clock::now();
+	long sum = 0;
+	for (long k = 0; k < n; ++k) {
+		sum += f(static_cast<int>(k));
+		asm volatile("" : "+r"(sum)); // every call has to happen, the loop cannot be folded away
+	}
+	std::chrono::duration<double, std::nano> took = std::chrono::steady_clock::now() - start;
+	std::cout << name << ": " << took.count() / n << " ns/call" << std::endl;
+}
+
+// keeps the compiler from seeing which implementation is behind the erased wrapper
+__attribute__((noinline)) bench_wrapper& erase(bench_wrapper& w) {
+	asm volatile("" : : "r"(&w) : "memory");
+	return w;
+}
+
+int main() {
+	const long n = 200000000;
+	bench_creator::inline_type sealed(1);
+	bench_wrapper& erased = erase(sealed);
+
+	bench("interface_wrapper::call (type-erased)", n, [&](int k) { return erased.call(&interface1::twice, k); });
+	bench("interface_wrapper::operator[] (type-erased)", n, [&](int k) { return erased[&interface1::twice](k); });
+	bench("sealed apply<interface1>", n, [&](int k) { return sealed.apply<interface1>([k](c_handler1& h) { return h.twice(k); }); });
+	bench("sealed concrete<interface1>()", n, [&](int k) { return sealed.concrete<interface1>().twice(k); });
+
+#ifdef INTERFACE_WRAPPER_INSTRUMENTATION
+	instrumentation::name(&interface1::twice, "interface1::twice");
+	instrumentation::dump_json(std::cout);
+#endif
+
+	return 0;
+}
+
+#endif
@@ -2,6 +2,7 @@
 #include <functional>
 #include <algorithm>
 #include <memory>
+#include <string>
 
 template <typename RV, typename... Ts>
 struct Visitor {
@@ -1,7 +1,21 @@
+#include <cstddef>
+
 struct Visitable {
 	virtual void accept(const struct AnyVisitor&) = 0;
+
+	// index of the concrete type in its closed type set (see visitable_in / multi_dispatcher)
+	static constexpr std::size_t no_dispatch_id = static_cast<std::size_t>(-1);
+	std::size_t dispatch_id() const { return _dispatch_id; }
+
+protected:
+	Visitable() = default;
+	Visitable(std::size_t id): _dispatch_id(id) {}
+
+private:
+	std::size_t _dispatch_id = no_dispatch_id;
 };
 
+#include <functional>
 #include <memory>
 #include <stdexcept>
 struct AnyVisitor {
@@ -42,12 +56,150 @@ public:
 };
 
 
-struct DerivedClass1: public Visitable
+/* multiple dispatch over a closed set of Visitable types */
+
+#include <utility>
+#include <type_traits>
+
+template <typename... Ts> struct type_set {};
+
+namespace detail {
+	template <typename T, typename... Ts> struct index_of;
+
+	template <typename T, typename... Ts>
+	struct index_of<T, T, Ts...>: std::integral_constant<std::size_t, 0> {};
+
+	template <typename T, typename U, typename... Ts>
+	struct index_of<T, U, Ts...>: std::integral_constant<std::size_t, 1 + index_of<T, Ts...>::value> {};
+
+	template <std::size_t I, typename T, typename... Ts>
+	struct type_at { using type = typename type_at<I - 1, Ts...>::type; };
+
+	template <typename T, typename... Ts>
+	struct type_at<0, T, Ts...> { using type = T; };
+
+	template <typename...> struct void_type { using type = void; };
+
+	template <typename F, typename Args, typename = void>
+	struct is_callable: std::false_type {};
+
+	template <typename F, typename... Args>
+	struct is_callable<F, type_set<Args...>, typename void_type<decltype(std::declval<const F&>()(std::declval<Args>()...))>::type>: std::true_type {};
+
+	constexpr std::size_t pow(std::size_t base, std::size_t exp) { return exp == 0? 1 : base * pow(base, exp - 1); }
+
+	// P-th (most significant first) base-N digit of the flat table index K
+	constexpr std::size_t digit(std::size_t K, std::size_t N, std::size_t arity, std::size_t P) {
+		return K / pow(N, arity - P - 1) % N;
+	}
+
+	// C++14 has no pack expansion in using-declarations, hence the recursion
+	template <typename F, typename... Fs>
+	struct overloaded: F, overloaded<Fs...> {
+		overloaded(F f, Fs... fs): F(std::move(f)), overloaded<Fs...>(std::move(fs)...) {}
+		using F::operator();
+		using overloaded<Fs...>::operator();
+	};
+
+	template <typename F>
+	struct overloaded<F>: F {
+		overloaded(F f): F(std::move(f)) {}
+		using F::operator();
+	};
+} // detail
+
+// Stamps the index of Derived in the closed set at construction - no virtual call is needed to read it back
+template <typename Derived, typename Set> struct visitable_in;
+
+template <typename Derived, typename... Ts>
+struct visitable_in<Derived, type_set<Ts...>>: Visitable {
+	visitable_in(): Visitable(detail::index_of<Derived, Ts...>::value) {}
+};
+
+/*
+Every combination of types from the set gets its own thunk, laid out in one flat table indexed by the
+dispatch ids of the arguments - calling a handler is one table load and one indirect call.
+For pairs without a matching handler the swapped pair is tried (symmetric handlers only need to be written once),
+anything else throws like AnyVisitor does.
+*/
+template <typename RV, typename Set, typename F, std::size_t Arity = 2> struct multi_dispatcher;
+
+template <typename RV, typename... Ts, typename F, std::size_t Arity>
+struct multi_dispatcher<RV, type_set<Ts...>, F, Arity> {
+	static constexpr std::size_t types = sizeof...(Ts);
+	static constexpr std::size_t table_size = detail::pow(types, Arity);
+
+	multi_dispatcher(F f): f(std::move(f)) {}
+
+	template <typename... Vs>
+	RV operator()(Vs&... args) const {
+		static_assert(sizeof...(Vs) == Arity, "Wrong number of arguments for this dispatcher");
+		return table()[flat_index(args...)](f, args...);
+	}
+
+private:
+	F f;
+
+	template <typename... Vs> using thunk_t = RV (*)(const F&, Vs&...);
+
+	static std::size_t flat_index() { return 0; }
+
+	template <typename... Vs>
+	static std::size_t flat_index(const Visitable& v, const Vs&... rest) {
+		if (v.dispatch_id() >= types) throw std::runtime_error("Type outside of the dispatch set");
+		return v.dispatch_id() * detail::pow(types, sizeof...(Vs)) + flat_index(rest...);
+	}
+
+	template <typename... As>
+	static RV invoke(std::true_type, const F& f, As&... args) { return f(args...); }
+
+	template <typename A, typename B>
+	static RV invoke(std::false_type, const F& f, A& a, B& b) { return swapped(detail::is_callable<F, type_set<B&, A&>>{}, f, a, b); }
+
+	template <typename... As>
+	static RV invoke(std::false_type, const F&, As&...) { throw std::runtime_error("No handler for this combination of types"); }
+
+	template <typename A, typename B>
+	static RV swapped(std::true_type, const F& f, A& a, B& b) { return f(b, a); }
+
+	template <typename A, typename B>
+	static RV swapped(std::false_type, const F&, A&, B&) { throw std::runtime_error("No handler for this combination of types"); }
+
+	template <std::size_t K, std::size_t... P, typename... Vs>
+	static RV thunk(std::index_sequence<P...>, const F& f, Vs&... args) {
+		return invoke(
+			detail::is_callable<F, type_set<typename detail::type_at<detail::digit(K, types, Arity, P), Ts...>::type&...>>{},
+			f, static_cast<typename detail::type_at<detail::digit(K, types, Arity, P), Ts...>::type&>(args)...);
+	}
+
+	template <std::size_t K, typename... Vs>
+	static RV thunk(const F& f, Vs&... args) { return thunk<K>(std::make_index_sequence<Arity>{}, f, args...); }
+
+	template <typename V, std::size_t> using repeat = V;
+
+	template <std::size_t... K, std::size_t... P>
+	static const thunk_t<repeat<Visitable, P>...>* make_table(std::index_sequence<K...>, std::index_sequence<P...>) {
+		static constexpr thunk_t<repeat<Visitable, P>...> table[] = { &thunk<K, repeat<Visitable, P>...>... };
+		return table;
+	}
+
+	static auto table() { return make_table(std::make_index_sequence<table_size>{}, std::make_index_sequence<Arity>{}); }
+};
+
+template <typename RV, typename Set, std::size_t Arity = 2, typename... Fs>
+multi_dispatcher<RV, Set, detail::overloaded<Fs...>, Arity> make_multi_dispatcher(Fs... fs) {
+	return { detail::overloaded<Fs...>(std::move(fs)...) };
+}
+
+
+using dispatch_set = type_set<struct DerivedClass1, struct DerivedClass2>;
+
+struct DerivedClass1: public visitable_in<DerivedClass1, dispatch_set>
 {
 	void accept(const AnyVisitor& v) override { v.visit(*this); }
 };
 
-struct DerivedClass2: public Visitable
+struct DerivedClass2: public visitable_in<DerivedClass2, dispatch_set>
 {
 	void accept(const AnyVisitor& v) override { v.visit(*this); }
 };
@@ -55,6 +207,8 @@ struct DerivedClass2: public Visitable
 
 #include <vector>
 #include <iostream>
+#include <string>
+#include <cassert>
 int main() {
 
 	std::function<void(DerivedClass1&)> fsd1 = [](DerivedClass1&){ std::cout << "c1" <<std::endl; };
@@ -89,4 +243,29 @@ int main() {
 	fsd1 = std::function<void(DerivedClass1&)>{[](DerivedClass1&){ std::cout << "c12" <<std::endl; }};
 	objs[2]->accept(v);
 
+
+	// pairwise dispatch - (DerivedClass2, DerivedClass1) is served by the swapped handler
+	auto collide = make_multi_dispatcher<std::string, dispatch_set>(
+		[](DerivedClass1&, DerivedClass1&) { return std::string("1-1"); },
+		[](DerivedClass1&, DerivedClass2&) { return std::string("1-2"); }
+	);
+
+	assert(collide(*objs[1], *objs[2]) == "1-1");
+	assert(collide(*objs[1], *objs[0]) == "1-2");
+	assert(collide(*objs[0], *objs[1]) == "1-2");
+
+	bool thrown = false;
+	try { collide(*objs[0], *objs[0]); } catch (const std::runtime_error&) { thrown = true; }
+	assert(thrown);
+
+	// N-ary dispatch with a catch-all for everything that is not handled explicitly
+	auto triple = make_multi_dispatcher<int, dispatch_set, 3>(
+		[](DerivedClass2&, DerivedClass1&, DerivedClass2&) { return 212; },
+		[](Visitable&, Visitable&, Visitable&) { return 0; }
+	);
+
+	assert(triple(*objs[0], *objs[1], *objs[0]) == 212);
+	assert(triple(*objs[1], *objs[1], *objs[1]) == 0);
+
+	return 0;
 }
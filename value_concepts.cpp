@@ -3,8 +3,17 @@
 #include <vector>
 #include <string>
 #include <memory>
+#include <new>
+#include <cstddef>
+#include <type_traits>
+#include <utility>
 #include <iostream>
 #include <sstream>
+#include <stdexcept>
+#include <mutex>
+#include <atomic>
+#include <cstdint>
+#include <typeinfo>
 
 /* Re-iteration on value polymorphism with C++20 */
 
@@ -31,11 +40,35 @@ void draw(const T &entry, std::ostream &out, int position)
 	out << std::string(position, ' ') << entry << '\n';
 }
 
+/* buffer based rendering, produces the same bytes as draw - see render(const document_t &, ...) */
+template <typename T>
+void render(const T &entry, std::string &out, int position);
+
+class document_t;
+
+/* flat binary format, see the flat namespace below */
+namespace flat {
+	struct entry {
+		std::uint32_t tag;
+		std::uint32_t reserved;
+		std::uint64_t value; /* the int itself, or the offset of a blob or a document */
+	};
+
+	class writer;
+
+	template <typename T>
+	entry encode(writer &out, const T &value);
+}
+
 class drawable_ptr {
 	struct drawable_ptr_api {
 		virtual ~drawable_ptr_api() = default;
 		virtual void draw(std::ostream &out, int position) const = 0;
-		virtual std::unique_ptr<drawable_ptr_api> copy() const = 0;
+		virtual drawable_ptr_api *copy(void *buffer) const = 0; /* inline entries, and entries handed out by document_t */
+		virtual drawable_ptr_api *move(void *buffer) noexcept = 0; /* only used for entries stored inline */
+		virtual void render(std::string &out, int position) const = 0;
+		virtual const document_t *as_document() const = 0;
+		virtual flat::entry encode(flat::writer &out) const = 0;
 	};
 
 	template <DrawableEntry DE>
@@ -43,19 +76,123 @@ class drawable_ptr {
 		DE _data;
 		drawable_ptr_te(DE &&data): _data(std::move(data)) {}
 		void draw(std::ostream &out, int position) const final { return ::draw(this->_data, out, position); }
-		std::unique_ptr<drawable_ptr_api> copy() const final { return std::make_unique<drawable_ptr_te<DE>>(DE(this->_data)); }
+		drawable_ptr_api *copy(void *buffer) const final { return drawable_ptr::create<DE>(DE(this->_data), buffer); }
+		drawable_ptr_api *move(void *buffer) noexcept final { return ::new (buffer) drawable_ptr_te<DE>(std::move(this->_data)); }
+		void render(std::string &out, int position) const final { ::render(this->_data, out, position); }
+		const document_t *as_document() const final {
+			if constexpr (std::same_as<DE, document_t>) {
+				return &this->_data;
+			} else {
+				return nullptr;
+			}
+		}
+		flat::entry encode(flat::writer &out) const final { return flat::encode(out, this->_data); }
 	};
 
-	std::unique_ptr<drawable_ptr_api> _ptr;
+	/* entries are immutable once created, so the big ones are shared between copies instead of being cloned */
+	using shared_entry = std::shared_ptr<drawable_ptr_api>;
+
+	/* small buffer - big enough for a std::string, most entries never touch the heap */
+	static constexpr std::size_t inline_size = 5 * sizeof(void *);
+	static_assert(sizeof(shared_entry) <= inline_size);
+
+	template <DrawableEntry DE>
+	static constexpr bool fits_inline = sizeof(drawable_ptr_te<DE>) <= inline_size
+		&& alignof(drawable_ptr_te<DE>) <= alignof(std::max_align_t)
+		&& std::is_nothrow_move_constructible_v<DE>; /* moving the drawable_ptr moves the entry */
+
+	/* inline entries are constructed in buffer, otherwise buffer holds the shared_entry owning the heap one */
+	template <DrawableEntry DE>
+	static drawable_ptr_api *create(DE &&data, void *buffer) {
+		if constexpr (fits_inline<DE>) {
+			return ::new (buffer) drawable_ptr_te<DE>(std::move(data));
+		} else {
+			return (::new (buffer) shared_entry(std::make_shared<drawable_ptr_te<DE>>(std::move(data))))->get();
+		}
+	}
+
+	alignas(std::max_align_t) std::byte _buffer[inline_size];
+	drawable_ptr_api *_ptr;
+
+	bool is_inline() const { return static_cast<const void *>(_ptr) == _buffer; }
+	shared_entry &shared() { return *std::launder(reinterpret_cast<shared_entry *>(_buffer)); }
+	const shared_entry &shared() const { return *std::launder(reinterpret_cast<const shared_entry *>(_buffer)); }
+
+	void take(drawable_ptr &&other) noexcept {
+		if (other.is_inline()) {
+			_ptr = other._ptr->move(_buffer);
+		} else {
+			_ptr = (::new (_buffer) shared_entry(std::move(other.shared())))->get();
+		}
+	}
+
+	void reset() noexcept {
+		if (is_inline()) {
+			_ptr->~drawable_ptr_api();
+		} else {
+			shared().~shared_entry();
+		}
+	}
 
 public:
-	drawable_ptr(const drawable_ptr &other): _ptr(other._ptr->copy()) {}
-	drawable_ptr(drawable_ptr &&other): _ptr(std::move(other)._ptr) {}
+	/* an entry inside a document_t, valid until the document is modified - copy it into a drawable_ptr to keep it */
+	class ref {
+		const drawable_ptr_api *_ptr;
+
+		explicit ref(const drawable_ptr_api *ptr): _ptr(ptr) {}
+
+	public:
+		template <DrawableEntry DE>
+		const DE *get_if() const {
+			auto te = dynamic_cast<const drawable_ptr_te<DE> *>(_ptr);
+			return te? &te->_data : nullptr;
+		}
+
+		const document_t *as_document() const { return _ptr->as_document(); }
+
+		friend drawable_ptr;
+		friend document_t;
+		friend void draw<ref>(const ref &entry, std::ostream &out, int position);
+		friend void render<ref>(const ref &entry, std::string &out, int position);
+		friend flat::entry flat::encode<ref>(flat::writer &out, const ref &entry);
+	};
+
+	drawable_ptr(const ref &entry): _ptr(entry._ptr->copy(_buffer)) {}
+	drawable_ptr(const drawable_ptr &other):
+		_ptr(other.is_inline()? other._ptr->copy(_buffer) : (::new (_buffer) shared_entry(other.shared()))->get()) {}
+	drawable_ptr(drawable_ptr &&other) noexcept { take(std::move(other)); }
 
 	template <DrawableEntry DE> /* pretty cool addition - helps with understanding the code, much better than duck-typed typename T, and also more consise and descriptive than enable_if */
-	drawable_ptr(DE data): _ptr(std::make_unique<drawable_ptr_te<DE>>(std::move(data))) {}
+	drawable_ptr(DE data): _ptr(create<DE>(std::move(data), _buffer)) {}
+
+	~drawable_ptr() { reset(); }
+
+	drawable_ptr &operator=(const drawable_ptr &other) {
+		if (this != &other) *this = drawable_ptr(other);
+		return *this;
+	}
 
+	drawable_ptr &operator=(drawable_ptr &&other) noexcept {
+		if (this != &other) {
+			reset();
+			take(std::move(other));
+		}
+		return *this;
+	}
+
+	/* the entry if it holds a DE, nullptr otherwise */
+	template <DrawableEntry DE>
+	const DE *get_if() const {
+		auto te = dynamic_cast<const drawable_ptr_te<DE> *>(_ptr);
+		return te? &te->_data : nullptr;
+	}
+
+	/* the nested document if the entry is one, cheaper than get_if<document_t> */
+	const document_t *as_document() const { return _ptr->as_document(); }
+
+	friend document_t;
 	friend void draw<drawable_ptr>(const drawable_ptr &entry, std::ostream &out, int position);
+	friend void render<drawable_ptr>(const drawable_ptr &entry, std::string &out, int position);
 };
 
 template <>
@@ -63,13 +200,803 @@ void draw(const drawable_ptr &entry, std::ostream &out, int position) {
 	entry._ptr->draw(out, position);
 }
 
-using document_t = std::vector<drawable_ptr>;
+template <>
+void draw(const drawable_ptr::ref &entry, std::ostream &out, int position) {
+	entry._ptr->draw(out, position);
+}
+
+/*
+Copy-on-write document - copies share the entries and are O(1). The entries are kept in chunks of chunk_size,
+the first modification of a shared document copies its list of chunks and the one chunk it touches (not the
+entries themselves, big ones are shared and small ones are cheap to copy).
+Nested documents are entries like any other, edit<document_t>() on one copies only the documents on the way to it.
+*/
+class document_t {
+	static constexpr std::size_t chunk_size = 256;
+
+	/*
+	A chunk of entries of one small type is a typed_chunk, stored contiguously without a drawable_ptr per entry,
+	anything else is a mixed_chunk. Drawing and rendering dispatch once per chunk, a typed_chunk calls the draw / render
+	of its type directly in a loop.
+	*/
+	struct chunk {
+		virtual ~chunk() = default;
+		virtual std::shared_ptr<chunk> clone() const = 0;
+		virtual std::size_t size() const = 0;
+		virtual drawable_ptr::ref at(std::size_t i) const = 0;
+		virtual bool push_back(drawable_ptr &entry) = 0; /* false when the chunk cannot hold the entry, it is left as is */
+		virtual bool set(std::size_t i, drawable_ptr &entry) = 0;
+		virtual void nested(std::vector<std::size_t> &indices) const = 0; /* of the nested documents */
+		virtual void draw(std::size_t begin, std::size_t end, std::ostream &out, int position) const = 0;
+		virtual void render(std::size_t begin, std::size_t end, std::string &out, int position) const = 0;
+	};
+
+	struct mixed_chunk final: chunk {
+		std::vector<drawable_ptr> entries;
+
+		mixed_chunk() { entries.reserve(chunk_size); }
+		mixed_chunk(const mixed_chunk &other): mixed_chunk() { entries.insert(entries.end(), other.entries.begin(), other.entries.end()); }
+
+		std::shared_ptr<chunk> clone() const final { return std::make_shared<mixed_chunk>(*this); }
+		std::size_t size() const final { return entries.size(); }
+		drawable_ptr::ref at(std::size_t i) const final { return drawable_ptr::ref(entries[i]._ptr); }
+
+		bool push_back(drawable_ptr &entry) final {
+			entries.push_back(std::move(entry));
+			return true;
+		}
+
+		bool set(std::size_t i, drawable_ptr &entry) final {
+			entries[i] = std::move(entry);
+			return true;
+		}
+
+		void nested(std::vector<std::size_t> &indices) const final {
+			for (std::size_t i = 0; i < entries.size(); ++i) {
+				if (entries[i].as_document()) indices.push_back(i);
+			}
+		}
+
+		void draw(std::size_t begin, std::size_t end, std::ostream &out, int position) const final {
+			for (std::size_t i = begin; i < end; ++i) entries[i]._ptr->draw(out, position);
+		}
+
+		void render(std::size_t begin, std::size_t end, std::string &out, int position) const final {
+			for (std::size_t i = begin; i < end; ++i) entries[i]._ptr->render(out, position);
+		}
+	};
+
+	template <DrawableEntry DE>
+	struct typed_chunk final: chunk {
+		using stored = drawable_ptr::drawable_ptr_te<DE>; /* what a drawable_ptr would hold inline, ref points at it */
+		std::vector<stored> entries;
+
+		typed_chunk() { entries.reserve(chunk_size); }
+		typed_chunk(const typed_chunk &other): typed_chunk() {
+			for (const auto &e: other.entries) entries.emplace_back(DE(e._data));
+		}
+
+		std::shared_ptr<chunk> clone() const final { return std::make_shared<typed_chunk>(*this); }
+		std::size_t size() const final { return entries.size(); }
+		drawable_ptr::ref at(std::size_t i) const final { return drawable_ptr::ref(&entries[i]); }
+
+		bool push_back(drawable_ptr &entry) final {
+			auto te = dynamic_cast<stored *>(entry._ptr);
+			if (!te) return false;
+			entries.emplace_back(std::move(te->_data));
+			return true;
+		}
+
+		bool set(std::size_t i, drawable_ptr &entry) final {
+			auto te = dynamic_cast<stored *>(entry._ptr);
+			if (!te) return false;
+			std::destroy_at(&entries[i]); /* DE does not have to be assignable, its move constructor does not throw */
+			std::construct_at(&entries[i], std::move(te->_data));
+			return true;
+		}
+
+		void nested(std::vector<std::size_t> &indices) const final {
+			if constexpr (std::same_as<DE, document_t>) {
+				for (std::size_t i = 0; i < entries.size(); ++i) indices.push_back(i);
+			}
+		}
+
+		void draw(std::size_t begin, std::size_t end, std::ostream &out, int position) const final {
+			for (std::size_t i = begin; i < end; ++i) ::draw(entries[i]._data, out, position);
+		}
+
+		void render(std::size_t begin, std::size_t end, std::string &out, int position) const final {
+			for (std::size_t i = begin; i < end; ++i) ::render(entries[i]._data, out, position);
+		}
+	};
+
+	/* types emplace_back keeps in typed chunks */
+	template <typename DE>
+	static constexpr bool typed() {
+		if constexpr (DrawableEntry<DE> && !std::same_as<DE, drawable_ptr::ref>) {
+			return drawable_ptr::fits_inline<DE>;
+		} else {
+			return false;
+		}
+	}
+
+	/*
+	Output of render_cached, one block per chunk rendered at cache_position - null blocks are stale.
+	Nested documents are not part of the block, they are rendered from their own caches between its runs.
+	*/
+	struct cached_block {
+		std::vector<std::string> runs;   /* output of the entries before, between and after the nested documents */
+		std::vector<std::size_t> nested; /* indices in the chunk of the nested documents, runs.size() == nested.size() + 1 */
+	};
+
+	struct node {
+		std::vector<std::shared_ptr<chunk>> chunks; /* all of them full but the last one, shared with copies of the node */
+		std::size_t size = 0;
+		mutable std::mutex cache_mutex;
+		mutable int cache_position = -1;
+		mutable std::vector<std::shared_ptr<const cached_block>> cache; /* shared with copies of the node */
+		mutable std::atomic<std::size_t> cache_bytes { 0 }; /* size of the last output, used to reserve the next one - read without the lock */
+
+		node() = default;
+		node(const node &other): chunks(other.chunks), size(other.size) {
+			std::lock_guard lock(other.cache_mutex);
+			cache_position = other.cache_position;
+			cache = other.cache;
+			cache_bytes.store(other.cache_bytes.load(std::memory_order_relaxed), std::memory_order_relaxed);
+		}
+
+		void invalidate(std::size_t index) {
+			if (index / chunk_size < cache.size()) cache[index / chunk_size].reset();
+		}
+	};
+
+	std::shared_ptr<node> _node;
+
+	node &mutable_node() {
+		if (!_node) {
+			_node = std::make_shared<node>();
+		} else if (_node.use_count() > 1) {
+			_node = std::make_shared<node>(*_node);
+		}
+		return *_node;
+	}
+
+	/* chunk of the entry about to be modified, or appended when touched == size() - its cached output is dropped */
+	std::shared_ptr<chunk> &mutable_chunk(std::size_t touched) {
+		auto &shared = mutable_node().chunks[touched / chunk_size];
+		if (shared.use_count() > 1) shared = shared->clone();
+		_node->invalidate(touched);
+		return shared;
+	}
+
+	/* the entries of c in a mixed_chunk, for an entry of another type */
+	static std::shared_ptr<chunk> mixed(const chunk &c) {
+		auto copy = std::make_shared<mixed_chunk>();
+		for (std::size_t i = 0; i < c.size(); ++i) copy->entries.emplace_back(c.at(i));
+		return copy;
+	}
+
+	template <DrawableEntry DE>
+	void append(DE &&value) {
+		if (size() % chunk_size == 0) mutable_node().chunks.push_back(std::make_shared<typed_chunk<DE>>());
+		auto &c = mutable_chunk(size());
+		if (typeid(*c) != typeid(typed_chunk<DE>)) return push_back(std::move(value));
+		static_cast<typed_chunk<DE> &>(*c).entries.emplace_back(std::move(value));
+		++_node->size;
+	}
+
+	/* f(chunk, first, last) for the pieces of the entries [begin, end) in each chunk, in document order */
+	template <typename F>
+	void for_each_chunk(std::size_t begin, std::size_t end, F &&f) const {
+		while (begin < end) {
+			std::size_t c = begin / chunk_size, chunk_end = std::min(end, (c + 1) * chunk_size);
+			f(*_node->chunks[c], begin - c * chunk_size, chunk_end - c * chunk_size);
+			begin = chunk_end;
+		}
+	}
+
+	void check_index(std::size_t i) const {
+		if (i >= size()) throw std::out_of_range("Document entry index out of range");
+	}
+
+	friend class flat::writer;
+
+public:
+	using value_type = drawable_ptr;
+	using reference = drawable_ptr::ref;
+
+	class const_iterator {
+		const std::shared_ptr<chunk> *_chunk = nullptr;
+		std::size_t _index = 0; /* in the chunk */
+
+	public:
+		using iterator_category = std::input_iterator_tag;
+		using value_type = drawable_ptr;
+		using difference_type = std::ptrdiff_t;
+		using pointer = void;
+		using reference = drawable_ptr::ref;
+
+		const_iterator() = default;
+		const_iterator(const std::shared_ptr<chunk> *chunk, std::size_t index): _chunk(chunk), _index(index) {}
+
+		reference operator*() const { return (*_chunk)->at(_index); }
+
+		const_iterator &operator++() {
+			if (++_index == chunk_size) {
+				++_chunk;
+				_index = 0;
+			}
+			return *this;
+		}
+
+		const_iterator operator++(int) {
+			auto current = *this;
+			++*this;
+			return current;
+		}
+
+		bool operator==(const const_iterator &) const = default;
+	};
+
+	const_iterator begin() const { return _node? const_iterator(_node->chunks.data(), 0) : const_iterator(); }
+	const_iterator end() const { return _node? const_iterator(_node->chunks.data() + size() / chunk_size, size() % chunk_size) : const_iterator(); }
+	std::size_t size() const { return _node? _node->size : 0; }
+	bool empty() const { return size() == 0; }
+	reference operator[](std::size_t i) const { return _node->chunks[i / chunk_size]->at(i % chunk_size); }
+
+	void reserve(std::size_t n) { mutable_node().chunks.reserve((n + chunk_size - 1) / chunk_size); }
+
+	/* the entry is constructed first - document.emplace_back(document) must not make the document contain itself */
+	template <typename Arg>
+	void emplace_back(Arg &&arg) {
+		using DE = std::remove_cvref_t<Arg>;
+		if constexpr (typed<DE>()) {
+			append(DE(std::forward<Arg>(arg)));
+		} else {
+			push_back(drawable_ptr(std::forward<Arg>(arg)));
+		}
+	}
+
+	void push_back(drawable_ptr entry) {
+		if (size() % chunk_size == 0) mutable_node().chunks.push_back(std::make_shared<mixed_chunk>());
+		auto &c = mutable_chunk(size());
+		if (!c->push_back(entry)) {
+			c = mixed(*c);
+			c->push_back(entry);
+		}
+		++_node->size;
+	}
+
+	void set(std::size_t i, drawable_ptr entry) {
+		check_index(i);
+		auto &c = mutable_chunk(i);
+		if (!c->set(i % chunk_size, entry)) {
+			c = mixed(*c);
+			c->set(i % chunk_size, entry);
+		}
+	}
+
+	/* replaces the DE at i with f applied to a copy of it - copying a nested document_t is O(1) */
+	template <DrawableEntry DE, typename F>
+	void edit(std::size_t i, F &&f) {
+		check_index(i);
+		const DE *current = (*this)[i].template get_if<DE>();
+		if (!current) throw std::invalid_argument("Document entry has a different type");
+		DE copy = *current;
+		std::forward<F>(f)(copy);
+		set(i, std::move(copy));
+	}
+
+	/* draw / render of the entries [begin, end), one dispatch per chunk instead of one per entry */
+	void draw_entries(std::size_t begin, std::size_t end, std::ostream &out, int position) const {
+		for_each_chunk(begin, end, [&](const chunk &c, std::size_t first, std::size_t last) { c.draw(first, last, out, position); });
+	}
+
+	void render_entries(std::size_t begin, std::size_t end, std::string &out, int position) const {
+		for_each_chunk(begin, end, [&](const chunk &c, std::size_t first, std::size_t last) { c.render(first, last, out, position); });
+	}
+
+	/* appends the output of render, reusing whatever did not change since the last render_cached at this position */
+	void render_cached(std::string &out, int position) const;
+
+	std::size_t cached_size_hint() const { return _node? _node->cache_bytes.load(std::memory_order_relaxed) : 0; }
+};
 
 template <>
 void draw(const document_t &document, std::ostream &out, int position) {
 	out << std::string(position, ' ') << "<document>\n";
-	for (const auto &entry: document) {
-		draw(entry, out, position + 2);
+	document.draw_entries(0, document.size(), out, position + 2);
+	out << std::string(position, ' ') << "</document>\n";
+}
+
+
+/* render backend */
+
+#include <algorithm>
+#include <charconv>
+#include <streambuf>
+#include <thread>
+
+namespace detail {
+	/* shared by all of the renders, deeper indentation is appended in pieces */
+	inline constexpr std::string_view indentation_table = "                                                                                                                                ";
+
+	inline void indent(std::string &out, int position) {
+		for (; position > 0; position -= static_cast<int>(indentation_table.size())) {
+			out.append(indentation_table.data(), std::min<std::size_t>(position, indentation_table.size()));
+		}
+	}
+
+	/* streambuf appending to a std::string - lets render fall back to draw for types without a fast path */
+	struct string_appender: std::streambuf {
+		std::string *target = nullptr;
+		int_type overflow(int_type c) override {
+			if (c != traits_type::eof()) target->push_back(static_cast<char>(c));
+			return c;
+		}
+		std::streamsize xsputn(const char *s, std::streamsize n) override {
+			target->append(s, static_cast<std::size_t>(n));
+			return n;
+		}
+	};
+
+	/* one ostream per thread, constructing one per entry would cost more than the entry itself */
+	inline std::ostream &stream_into(std::string &out) {
+		thread_local string_appender buffer;
+		thread_local std::ostream stream(&buffer);
+		buffer.target = &out;
+		return stream;
+	}
+} // detail
+
+/* anything without a fast path goes through its draw, including user specializations */
+template <typename T>
+void render(const T &entry, std::string &out, int position) {
+	draw(entry, detail::stream_into(out), position);
+}
+
+/* fast paths - these assume the generic draw is used for int and std::string */
+template <>
+void render(const int &entry, std::string &out, int position) {
+	detail::indent(out, position);
+	char digits[16];
+	auto end = std::to_chars(digits, digits + sizeof(digits), entry).ptr;
+	out.append(digits, end);
+	out.push_back('\n');
+}
+
+template <>
+void render(const std::string &entry, std::string &out, int position) {
+	detail::indent(out, position);
+	out.append(entry);
+	out.push_back('\n');
+}
+
+template <>
+void render(const drawable_ptr &entry, std::string &out, int position) {
+	entry._ptr->render(out, position);
+}
+
+template <>
+void render(const drawable_ptr::ref &entry, std::string &out, int position) {
+	entry._ptr->render(out, position);
+}
+
+template <>
+void render(const document_t &document, std::string &out, int position) {
+	detail::indent(out, position);
+	out.append("<document>\n");
+	document.render_entries(0, document.size(), out, position + 2);
+	detail::indent(out, position);
+	out.append("</document>\n");
+}
+
+struct render_options {
+	unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+	std::size_t grain = 16384; /* entries per task, nested documents at least this big get their own tasks */
+};
+
+namespace detail {
+	/* a piece of the output - either a range of a document's entries or a document header / footer */
+	struct render_segment {
+		const document_t *document;
+		std::size_t begin, end;
+		int position;
+		const char *literal; /* when set, the segment is this tag at position */
+	};
+
+	inline void plan_render(const document_t &document, int position, std::size_t grain, std::vector<render_segment> &segments) {
+		segments.push_back({ nullptr, 0, 0, position, "<document>\n" });
+		std::size_t range_begin = 0;
+		auto flush = [&](std::size_t range_end) {
+			if (range_end > range_begin) segments.push_back({ &document, range_begin, range_end, position + 2, nullptr });
+			range_begin = range_end;
+		};
+		for (std::size_t i = 0; i < document.size(); ++i) {
+			const document_t *nested = document[i].as_document();
+			if (nested && nested->size() >= grain) {
+				flush(i);
+				plan_render(*nested, position + 2, grain, segments);
+				range_begin = i + 1;
+			} else if (i + 1 - range_begin >= grain) {
+				flush(i + 1);
+			}
+		}
+		flush(document.size());
+		segments.push_back({ nullptr, 0, 0, position, "</document>\n" });
+	}
+} // detail
+
+/*
+Same bytes as draw(document, out, position), rendered into per-segment buffers by options.threads threads
+and joined in document order.
+*/
+std::string render(const document_t &document, int position = 0, render_options options = {}) {
+	std::vector<detail::render_segment> segments;
+	detail::plan_render(document, position, std::max<std::size_t>(options.grain, 1), segments);
+
+	std::vector<std::string> buffers(segments.size());
+	std::atomic<std::size_t> next { 0 };
+	auto worker = [&] {
+		for (std::size_t s; (s = next.fetch_add(1, std::memory_order_relaxed)) < segments.size();) {
+			const auto &segment = segments[s];
+			auto &buffer = buffers[s];
+			if (segment.literal) {
+				detail::indent(buffer, segment.position);
+				buffer.append(segment.literal);
+				continue;
+			}
+			buffer.reserve((segment.end - segment.begin) * (segment.position + 16)); /* a guess, saves most of the regrowth */
+			segment.document->render_entries(segment.begin, segment.end, buffer, segment.position);
+		}
+	};
+
+	{
+		std::vector<std::jthread> threads;
+		for (unsigned t = 1; t < std::min<std::size_t>(options.threads, segments.size()); ++t) threads.emplace_back(worker);
+		worker();
+	}
+
+	std::size_t total = 0;
+	for (const auto &b: buffers) total += b.size();
+	std::string result;
+	result.reserve(total);
+	for (const auto &b: buffers) result.append(b);
+	return result;
+}
+
+void document_t::render_cached(std::string &out, int position) const {
+	std::size_t start = out.size();
+	detail::indent(out, position);
+	out.append("<document>\n");
+	std::unique_lock<std::mutex> lock;
+	if (_node) {
+		lock = std::unique_lock(_node->cache_mutex);
+		auto &cache = _node->cache;
+		if (_node->cache_position != position) {
+			cache.clear();
+			_node->cache_position = position;
+		}
+
+		const auto &chunks = _node->chunks;
+		cache.resize(chunks.size());
+		for (std::size_t b = 0; b < cache.size(); ++b) {
+			const chunk &entries = *chunks[b];
+			if (!cache[b]) {
+				auto block = std::make_shared<cached_block>();
+				entries.nested(block->nested);
+				std::size_t first = 0;
+				for (auto i: block->nested) {
+					entries.render(first, i, block->runs.emplace_back(), position + 2);
+					first = i + 1;
+				}
+				entries.render(first, entries.size(), block->runs.emplace_back(), position + 2);
+				cache[b] = std::move(block);
+			}
+
+			/* nested documents keep their own caches, an edit deep down re-renders only its path */
+			const auto &block = *cache[b];
+			out.append(block.runs[0]);
+			for (std::size_t k = 0; k < block.nested.size(); ++k) {
+				entries.at(block.nested[k]).as_document()->render_cached(out, position + 2);
+				out.append(block.runs[k + 1]);
+			}
+		}
+	}
+	detail::indent(out, position);
+	out.append("</document>\n");
+	if (_node) _node->cache_bytes.store(out.size() - start, std::memory_order_relaxed);
+}
+
+/* render with per-document output caches, same bytes as draw */
+std::string render_cached(const document_t &document, int position = 0) {
+	std::string out;
+	out.reserve(document.cached_size_hint());
+	document.render_cached(out, position);
+	return out;
+}
+
+
+/* flat binary format */
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <string_view>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/*
+Documents written out as one buffer that can be memory-mapped and drawn as is, without rebuilding the document_t.
+Everything is 8 byte aligned and in native byte order, offsets are from the start of the buffer:
+
+	header    char magic[8], u64 root      - offset of the root document
+	document  u64 count, entry[count]
+	entry     u32 tag, u32 reserved, u64 value
+	blob      u64 size, char[size], padded - std::string and user type entries
+
+Nested documents are written before the documents containing them, readers reject any other order - it could be a cycle.
+A document shared by several copies is written once.
+User types are written and drawn by their codec<T>, readers find the codec by its tag once it is registered.
+*/
+namespace flat {
+	inline constexpr char magic[8] = { 'v', 'c', 'd', 'o', 'c', '\0', '\0', '\1' };
+
+	inline constexpr std::uint32_t int_tag = 0;
+	inline constexpr std::uint32_t string_tag = 1;
+	inline constexpr std::uint32_t document_tag = 2;
+	inline constexpr std::uint32_t first_user_tag = 16;
+
+	/*
+	Specialized for user types:
+		static constexpr std::uint32_t tag;  - first_user_tag or above, small, unique and never reused
+		static void write(const T &, std::string &payload);
+		static void draw(std::string_view payload, std::ostream &out, int position);  - same output as draw(const T &, ...)
+	*/
+	template <typename T>
+	struct codec {};
+
+	using draw_payload = void (*)(std::string_view payload, std::ostream &out, int position);
+
+	namespace detail {
+		/* indexed by tag - first_user_tag, filled before main by the registrations */
+		inline std::vector<draw_payload> &user_types() {
+			static std::vector<draw_payload> table;
+			return table;
+		}
+
+		template <typename V>
+		V read(std::string_view data, std::uint64_t offset) {
+			if (offset > data.size() || data.size() - offset < sizeof(V)) throw std::out_of_range("Flat document offset out of bounds");
+			V value;
+			std::memcpy(&value, data.data() + offset, sizeof(V));
+			return value;
+		}
+	}
+
+	/* a static registration<T> makes documents holding T drawable from a mapping, see UserDefinedType */
+	template <typename T>
+	struct registration {
+		registration() {
+			static_assert(codec<T>::tag >= first_user_tag);
+			auto &table = detail::user_types();
+			std::size_t index = codec<T>::tag - first_user_tag;
+			if (table.size() <= index) table.resize(index + 1);
+			if (table[index] && table[index] != &codec<T>::draw) throw std::logic_error("Flat tag registered twice");
+			table[index] = &codec<T>::draw;
+		}
+	};
+
+	class writer {
+		std::string _buffer;
+		std::string _payload; /* reused by the codecs */
+		std::map<const void *, std::uint64_t> _documents; /* offsets of the nodes already written */
+
+		template <typename V>
+		void put(const V &value) { _buffer.append(reinterpret_cast<const char *>(&value), sizeof(V)); }
+
+	public:
+		writer() {
+			_buffer.append(magic, sizeof(magic));
+			put(std::uint64_t(0));
+		}
+
+		std::uint64_t blob(std::string_view data) {
+			std::uint64_t offset = _buffer.size();
+			put(std::uint64_t(data.size()));
+			_buffer.append(data);
+			_buffer.append((8 - data.size() % 8) % 8, '\0');
+			return offset;
+		}
+
+		template <typename T>
+		entry user(const T &value) {
+			_payload.clear();
+			codec<T>::write(value, _payload);
+			return { codec<T>::tag, 0, blob(_payload) };
+		}
+
+		std::uint64_t document(const document_t &document);
+
+		std::string finish(std::uint64_t root) && {
+			std::memcpy(_buffer.data() + sizeof(magic), &root, sizeof(root));
+			return std::move(_buffer);
+		}
+	};
+
+	/* types without a codec cannot be written, documents holding them throw */
+	template <typename T>
+	entry encode(writer &out, const T &value) {
+		if constexpr (requires { codec<T>::tag; }) {
+			return out.user(value);
+		} else {
+			throw std::invalid_argument("Document entry type has no flat codec");
+		}
+	}
+
+	template <>
+	entry encode(writer &, const int &value) {
+		return { int_tag, 0, static_cast<std::uint64_t>(static_cast<std::int64_t>(value)) };
+	}
+
+	template <>
+	entry encode(writer &out, const std::string &value) {
+		return { string_tag, 0, out.blob(value) };
+	}
+
+	template <>
+	entry encode(writer &out, const document_t &value) {
+		return { document_tag, 0, out.document(value) };
+	}
+
+	template <>
+	entry encode(writer &out, const drawable_ptr::ref &value) {
+		return value._ptr->encode(out);
+	}
+
+	std::uint64_t writer::document(const document_t &document) {
+		/* copies of a document share their entries until modified */
+		const void *key = document.empty()? nullptr : document._node.get();
+		if (key) {
+			if (auto written = _documents.find(key); written != _documents.end()) return written->second;
+		}
+
+		std::vector<entry> entries;
+		entries.reserve(document.size());
+		for (const auto &e: document) entries.push_back(encode(*this, e));
+
+		std::uint64_t offset = _buffer.size();
+		put(std::uint64_t(entries.size()));
+		_buffer.append(reinterpret_cast<const char *>(entries.data()), entries.size() * sizeof(entry));
+		if (key) _documents.emplace(key, offset);
+		return offset;
+	}
+
+	inline std::string serialize(const document_t &document) {
+		writer out;
+		std::uint64_t root = out.document(document);
+		return std::move(out).finish(root);
+	}
+
+	inline void save(const document_t &document, const std::filesystem::path &path) {
+		std::string data = serialize(document);
+		std::ofstream file(path, std::ios::binary | std::ios::trunc);
+		if (!file.write(data.data(), data.size())) throw std::runtime_error("Cannot write " + path.string());
+	}
+
+	class document_view;
+
+	/* an entry of a flat document, all of the accessors check the tag and the bounds */
+	class entry_view {
+		std::string_view _data;
+		entry _entry;
+		std::uint64_t _parent; /* offset of the document holding the entry */
+
+	public:
+		entry_view(std::string_view data, entry e, std::uint64_t parent): _data(data), _entry(e), _parent(parent) {}
+
+		std::uint32_t tag() const { return _entry.tag; }
+
+		int as_int() const {
+			if (_entry.tag != int_tag) throw std::invalid_argument("Flat entry is not an int");
+			return static_cast<int>(static_cast<std::int64_t>(_entry.value));
+		}
+
+		/* the string of a std::string entry, the codec payload of a user type */
+		std::string_view payload() const {
+			if (_entry.tag == int_tag || _entry.tag == document_tag) throw std::invalid_argument("Flat entry has no payload");
+			auto size = detail::read<std::uint64_t>(_data, _entry.value);
+			if (_data.size() - _entry.value - sizeof(size) < size) throw std::out_of_range("Flat document offset out of bounds");
+			return _data.substr(_entry.value + sizeof(size), size);
+		}
+
+		document_view as_document() const;
+	};
+
+	/* a document inside a flat buffer, nothing is copied out of the buffer */
+	class document_view {
+		std::string_view _data;
+		std::uint64_t _offset;
+		std::uint64_t _entries; /* offset of the first entry */
+		std::uint64_t _size;
+
+	public:
+		document_view(std::string_view data, std::uint64_t offset):
+			_data(data), _offset(offset), _entries(offset + sizeof(std::uint64_t)), _size(detail::read<std::uint64_t>(data, offset))
+		{
+			if ((data.size() - _entries) / sizeof(entry) < _size) throw std::out_of_range("Flat document offset out of bounds");
+		}
+
+		std::size_t size() const { return _size; }
+		bool empty() const { return _size == 0; }
+		entry_view operator[](std::size_t i) const {
+			if (i >= _size) throw std::out_of_range("Flat document entry index out of range");
+			return { _data, detail::read<entry>(_data, _entries + i * sizeof(entry)), _offset };
+		}
+	};
+
+	inline document_view entry_view::as_document() const {
+		if (_entry.tag != document_tag) throw std::invalid_argument("Flat entry is not a document");
+		/* nested documents are written before the documents holding them, anything else could be a cycle */
+		if (_entry.value >= _parent) throw std::out_of_range("Flat document is not written before its parent");
+		return { _data, _entry.value };
+	}
+
+	/* the root document of a buffer written by serialize */
+	inline document_view root(std::string_view data) {
+		if (data.size() < sizeof(magic) + sizeof(std::uint64_t) || std::memcmp(data.data(), magic, sizeof(magic)) != 0) {
+			throw std::invalid_argument("Not a flat document");
+		}
+		return { data, detail::read<std::uint64_t>(data, sizeof(magic)) };
+	}
+
+	/* read-only mapping of a file written by save, pages are loaded as drawing touches them */
+	class mapped_document {
+		void *_address = MAP_FAILED;
+		std::size_t _size = 0;
+
+	public:
+		explicit mapped_document(const std::filesystem::path &path) {
+			int fd = ::open(path.c_str(), O_RDONLY);
+			if (fd < 0) throw std::runtime_error("Cannot open " + path.string());
+			struct stat info;
+			if (::fstat(fd, &info) == 0 && info.st_size > 0) {
+				_size = static_cast<std::size_t>(info.st_size);
+				_address = ::mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+			}
+			::close(fd);
+			if (_address == MAP_FAILED) throw std::runtime_error("Cannot map " + path.string());
+		}
+
+		mapped_document(const mapped_document &) = delete;
+		mapped_document &operator=(const mapped_document &) = delete;
+		~mapped_document() { ::munmap(_address, _size); }
+
+		std::string_view data() const { return { static_cast<const char *>(_address), _size }; }
+		document_view root() const { return flat::root(data()); }
+	};
+} // flat
+
+template <>
+void draw(const flat::document_view &document, std::ostream &out, int position) {
+	out << std::string(position, ' ') << "<document>\n";
+	const auto &user_types = flat::detail::user_types();
+	for (std::size_t i = 0; i < document.size(); ++i) {
+		auto entry = document[i];
+		switch (entry.tag()) {
+		case flat::int_tag: draw(entry.as_int(), out, position + 2); break;
+		case flat::string_tag: draw(entry.payload(), out, position + 2); break;
+		case flat::document_tag: draw(entry.as_document(), out, position + 2); break;
+		default:
+			std::size_t index = entry.tag() - flat::first_user_tag;
+			if (entry.tag() < flat::first_user_tag || index >= user_types.size() || !user_types[index]) {
+				throw std::invalid_argument("Flat entry type is not registered");
+			}
+			user_types[index](entry.payload(), out, position + 2);
+		}
 	}
 	out << std::string(position, ' ') << "</document>\n";
 }
@@ -86,6 +1013,32 @@ void draw(const UserDefinedType &v, std::ostream &out, int position) {
 	out << std::string(position, ' ') << "</UserDefinedType value='" << v.value << std::string("'>\n");
 }
 
+/* UserDefinedType in flat documents, the payload is the value */
+template <>
+struct flat::codec<UserDefinedType> {
+	static constexpr std::uint32_t tag = flat::first_user_tag;
+
+	static void write(const UserDefinedType &v, std::string &payload) { payload.append(v.value); }
+
+	static void draw(std::string_view payload, std::ostream &out, int position) {
+		out << std::string(position, ' ') << "</UserDefinedType value='" << payload << "'>\n";
+	}
+};
+
+static const flat::registration<UserDefinedType> user_defined_type_registration;
+
+/* too big for drawable_ptr's inline buffer */
+struct UserDefinedMatrix {
+	double values[3][3];
+};
+
+template <>
+void draw(const UserDefinedMatrix &m, std::ostream &out, int position) {
+	out << std::string(position, ' ') << "</UserDefinedMatrix trace='" << m.values[0][0] + m.values[1][1] + m.values[2][2] << "'>\n";
+}
+
+#ifndef VALUE_CONCEPTS_BENCHMARK
+
 int main() {
 	document_t document;
 
@@ -116,5 +1069,301 @@ int main() {
 </document>
 )EOF"));
 
+	/* nesting a document in itself nests a copy, like it did with std::vector */
+	document_t self = document2;
+	self.emplace_back(self);
+	assert(self.size() == document2.size() + 1 && self[self.size() - 1].as_document()->size() == document2.size());
+
+	/* buffer based renderer has to produce exactly the same output, also when split into many tasks */
+	assert(render(document) == ss.str());
+	assert(render(document, 0, { .threads = 4, .grain = 1 }) == ss.str());
+
+	/* cached re-render - after an edit only the touched blocks are rendered again */
+	assert(render_cached(document) == ss.str());
+	document_t cached = document;
+	assert(render_cached(cached) == ss.str());
+	cached.edit<document_t>(3, [](document_t &nested) { nested.emplace_back(7); });
+	assert(render_cached(cached) == render(cached) && render_cached(cached, 4) == render(cached, 4));
+	assert(render_cached(document) == ss.str());
+	{
+		/* copies sharing the cache render it from several threads */
+		document_t first = document, second = document;
+		std::jthread other([&] { assert(render_cached(first) == ss.str()); });
+		assert(render_cached(second) == ss.str());
+	}
+
+	/* flat format - drawn straight from the buffer or from a mapping of the file */
+	std::string flat_document = flat::serialize(document);
+	std::stringstream flat_drawn;
+	draw(flat::root(flat_document), flat_drawn, 0);
+	assert(flat_drawn.str() == ss.str());
+	assert(flat::root(flat_document)[3].as_document().size() == document2.size());
+
+	/* a crafted document holding itself is rejected instead of drawn until the stack runs out */
+	document_t holder;
+	holder.emplace_back(document_t());
+	std::string cycle = flat::serialize(holder);
+	std::uint64_t cycle_root;
+	std::memcpy(&cycle_root, cycle.data() + sizeof(flat::magic), sizeof(cycle_root));
+	std::memcpy(cycle.data() + cycle_root + sizeof(std::uint64_t) + offsetof(flat::entry, value), &cycle_root, sizeof(cycle_root));
+	bool cyclic = false;
+	try {
+		std::stringstream cycle_drawn;
+		draw(flat::root(cycle), cycle_drawn, 0);
+	} catch (const std::out_of_range &) {
+		cyclic = true;
+	}
+	assert(cyclic);
+	bool past_the_end = false;
+	try {
+		flat::root(flat_document)[3].as_document()[document2.size()]; /* followed by more of the buffer */
+	} catch (const std::out_of_range &) {
+		past_the_end = true;
+	}
+	assert(past_the_end);
+
+	auto flat_path = std::filesystem::temp_directory_path() / "value_concepts.flat";
+	flat::save(document, flat_path);
+	{
+		flat::mapped_document mapped(flat_path);
+		std::stringstream mapped_drawn;
+		draw(mapped.root(), mapped_drawn, 0);
+		assert(mapped_drawn.str() == ss.str());
+	}
+	std::filesystem::remove(flat_path);
+
+	/* documents shared between copies are written once, types without a codec cannot be written */
+	document_t once, twice;
+	once.emplace_back(document2);
+	twice.emplace_back(document2);
+	twice.emplace_back(document2);
+	assert(flat::serialize(twice).size() == flat::serialize(once).size() + sizeof(flat::entry));
+
+	document_t matrix;
+	matrix.emplace_back(UserDefinedMatrix{});
+	bool unwritable = false;
+	try {
+		flat::serialize(matrix);
+	} catch (const std::invalid_argument &) {
+		unwritable = true;
+	}
+	assert(unwritable);
+
+	/* copies share everything until one of them is modified */
+	document_t variant = document;
+	variant.set(0, 43);
+	variant.edit<document_t>(3, [](document_t &nested) { nested.set(1, std::string("edited entry")); });
+	variant.emplace_back(UserDefinedMatrix{{{1, 0, 0}, {0, 2, 0}, {0, 0, 3}}});
+
+	document_t variant2 = variant;
+	variant2.edit<UserDefinedMatrix>(5, [](UserDefinedMatrix &m) { m.values[0][0] = 10; });
+
+	std::stringstream original;
+	draw(document, original, 0);
+	assert(original.str() == ss.str());
+	assert(document.size() == 5 && variant.size() == 6);
+
+	std::stringstream edited;
+	draw(variant, edited, 0);
+	assert(render(variant, 0, { .threads = 3, .grain = 2 }) == edited.str());
+	assert(edited.str() == std::string(R"EOF(<document>
+  43
+  string entry
+  </UserDefinedType value='user entry'>
+  <document>
+    42
+    edited entry
+    </UserDefinedType value='user entry'>
+    another string entry
+  </document>
+  yet another string entry
+  </UserDefinedMatrix trace='6'>
+</document>
+)EOF"));
+	assert(*variant[1].get_if<std::string>() == "string entry" && !variant[1].get_if<int>());
+	assert(variant2[5].get_if<UserDefinedMatrix>()->values[0][0] == 10 && variant[5].get_if<UserDefinedMatrix>()->values[0][0] == 1);
+
+	/* long documents are edited a chunk at a time, the copies still only see their own edits */
+	document_t numbers;
+	for (int i = 0; i < 1000; ++i) numbers.emplace_back(i);
+	document_t renumbered = numbers;
+	renumbered.set(700, -1);
+	renumbered.emplace_back(1000);
+	assert(numbers.size() == 1000 && renumbered.size() == 1001);
+	assert(*numbers[700].get_if<int>() == 700 && *renumbered[700].get_if<int>() == -1 && *renumbered[1000].get_if<int>() == 1000);
+	int expected = 0;
+	for (const auto &entry: numbers) assert(*entry.get_if<int>() == expected++);
+	assert(expected == 1000);
+	document_t both;
+	both.emplace_back(numbers);
+	both.emplace_back(renumbered);
+	assert(flat::root(flat::serialize(both))[0].as_document()[700].as_int() == 700);
+	assert(flat::root(flat::serialize(both))[1].as_document()[700].as_int() == -1);
+	assert(render_cached(both) == render(both, 0, { .threads = 2, .grain = 100 }));
+
+	/* chunks of one small type are stored typed, an entry of another type turns its chunk into a mixed one */
+	document_t blocks;
+	for (int i = 0; i < 600; ++i) blocks.emplace_back(i);
+	blocks.set(300, std::string("three hundred"));
+	blocks.push_back(drawable_ptr(600));
+	blocks.edit<int>(10, [](int &value) { value = -10; });
+	drawable_ptr kept = blocks[5];
+	blocks.set(5, 0);
+	std::stringstream per_entry, per_chunk;
+	for (const auto &entry: blocks) draw(entry, per_entry, 2);
+	blocks.draw_entries(0, blocks.size(), per_chunk, 2);
+	assert(per_entry.str() == per_chunk.str() && render(blocks) == render_cached(blocks));
+	assert(*blocks[300].get_if<std::string>() == "three hundred" && *blocks[600].get_if<int>() == 600);
+	assert(*blocks[10].get_if<int>() == -10 && *blocks[5].get_if<int>() == 0 && *kept.get_if<int>() == 5);
+
 	return 0;
 }
+
+#else // VALUE_CONCEPTS_BENCHMARK - build with optimizations
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <new>
+#include <optional>
+
+static std::atomic<std::size_t> allocations { 0 };
+
+void* operator new(std::size_t size) {
+	++allocations;
+	if (void* p = std::malloc(size ? size : 1)) return p;
+	throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+
+// discards the output, keeps the formatting work
+struct null_buffer: std::streambuf {
+	int overflow(int c) override { return c; }
+	std::streamsize xsputn(const char*, std::streamsize n) override { return n; }
+};
+
+template <typename F>
+double bench(const char* name, std::size_t entries, F f) {
+	std::size_t allocations_before = allocations;
+	auto start = std::chrono::steady_clock::now();
+	f();
+	std::chrono::duration<double, std::milli> took = std::chrono::steady_clock::now() - start;
+	std::cout << name << ": " << took.count() << " ms, " << (allocations - allocations_before) << " allocations ("
+	          << double(allocations - allocations_before) / entries << " per entry)" << std::endl;
+	return took.count();
+}
+
+void throughput(double ms, std::size_t bytes) {
+	std::cout << "    " << bytes / ms / 1000.0 << " MB/s" << std::endl;
+}
+
+int main() {
+	const std::size_t n = 1000000;
+	null_buffer nb;
+	std::ostream null_out(&nb);
+
+	document_t document;
+	document.reserve(n);
+	bench("build", n, [&] {
+		for (std::size_t i = 0; i < n; ++i) {
+			switch (i % 3) {
+			case 0: document.emplace_back(int(i)); break;
+			case 1: document.emplace_back(std::string("entry")); break;
+			case 2: document.emplace_back(UserDefinedType("user")); break;
+			}
+		}
+	});
+
+	std::optional<document_t> copy;
+	bench("copy", n, [&] { copy.emplace(document); });
+	bench("edit one entry of the copy", n, [&] { copy->set(n / 2, 7); });
+	bench("draw", n, [&] { draw(document, null_out, 0); });
+
+	/* 2 * 10^6 entries, half of them in a nested document */
+	document_t big = document;
+	big.emplace_back(document);
+
+	std::string drawn, rendered;
+	double ms = bench("draw into std::ostringstream (2M entries)", 2 * n, [&] {
+		std::ostringstream out;
+		draw(big, out, 0);
+		drawn = out.str();
+	});
+	throughput(ms, drawn.size());
+
+	for (unsigned threads: { 1u, 2u, 4u, std::thread::hardware_concurrency() }) {
+		std::string name = "render, " + std::to_string(threads) + " threads (2M entries)";
+		ms = bench(name.c_str(), 2 * n, [&] { rendered = render(big, 0, { .threads = threads }); });
+		throughput(ms, rendered.size());
+		assert(rendered == drawn);
+	}
+
+	/* loading a saved document - mapping it is all there is to it, the pages are read by the first draw */
+	auto flat_path = std::filesystem::temp_directory_path() / "value_concepts_benchmark.flat";
+	bench("flat save (2M entries)", 2 * n, [&] { flat::save(big, flat_path); });
+	std::optional<flat::mapped_document> mapped;
+	bench("flat map (2M entries)", 2 * n, [&] { mapped.emplace(flat_path); });
+	ms = bench("draw from the mapping into std::ostringstream (2M entries)", 2 * n, [&] {
+		std::ostringstream out;
+		draw(mapped->root(), out, 0);
+		rendered = out.str();
+	});
+	throughput(ms, rendered.size());
+	assert(rendered == drawn);
+	bench("draw from the mapping (2M entries)", 2 * n, [&] { draw(mapped->root(), null_out, 0); });
+	bench("draw (2M entries)", 2 * n, [&] { draw(big, null_out, 0); });
+	mapped.reset();
+	std::filesystem::remove(flat_path);
+
+	/* one virtual call per entry against one per chunk - runs of 1000 entries make most chunks typed */
+	const int repeat = 10;
+	document_t run_heavy, mixed;
+	for (std::size_t i = 0; i < n; ++i) {
+		if (i / 1000 % 2) run_heavy.emplace_back(std::string("entry")); else run_heavy.emplace_back(int(i));
+		if (i % 2) mixed.emplace_back(std::string("entry")); else mixed.emplace_back(int(i));
+	}
+	for (auto [name, doc]: { std::pair{ "run-heavy", &run_heavy }, std::pair{ "mixed", &mixed } }) {
+		std::string label = std::string(name) + ", draw per entry (10x)";
+		bench(label.c_str(), repeat * n, [&] {
+			for (int r = 0; r < repeat; ++r) for (const auto &entry: *doc) draw(entry, null_out, 2);
+		});
+		label = std::string(name) + ", draw per chunk (10x)";
+		bench(label.c_str(), repeat * n, [&] {
+			for (int r = 0; r < repeat; ++r) doc->draw_entries(0, doc->size(), null_out, 2);
+		});
+
+		/* rendered into once first, so the pages of the output are not faulted in by the measured runs */
+		std::string out, chunked;
+		doc->render_entries(0, doc->size(), out, 2);
+		doc->render_entries(0, doc->size(), chunked, 2);
+		label = std::string(name) + ", render per entry (10x)";
+		bench(label.c_str(), repeat * n, [&] {
+			for (int r = 0; r < repeat; ++r) {
+				out.clear();
+				for (const auto &entry: *doc) render(entry, out, 2);
+			}
+		});
+		label = std::string(name) + ", render per chunk (10x)";
+		bench(label.c_str(), repeat * n, [&] {
+			for (int r = 0; r < repeat; ++r) {
+				chunked.clear();
+				doc->render_entries(0, doc->size(), chunked, 2);
+			}
+		});
+		assert(out == chunked);
+	}
+
+	bench("render_cached, cold (2M entries)", 2 * n, [&] { rendered = render_cached(big); });
+	assert(rendered == drawn);
+	bench("render_cached, unchanged (2M entries)", 2 * n, [&] { rendered = render_cached(big); });
+	big.edit<document_t>(n, [](document_t &nested) { nested.set(12345, 54321); });
+	bench("edit one nested entry (2M entries)", 2 * n, [&] { big.edit<document_t>(n, [](document_t &nested) { nested.set(12345, 54321); }); });
+	bench("render_cached, after the edit (2M entries)", 2 * n, [&] { rendered = render_cached(big); });
+	assert(rendered == render(big));
+
+	return 0;
+}
+
+#endif